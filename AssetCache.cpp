@@ -0,0 +1,115 @@
+#include "AssetCache.h"
+#include <sys/stat.h>
+#include <iostream>
+
+AssetCache& AssetCache::instance() {
+    static AssetCache cache;
+    return cache;
+}
+
+AssetCache::AssetCache() : budget_bytes(64 * 1024 * 1024), used_bytes(0), hits(0), misses(0) {
+}
+
+void AssetCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget_bytes = bytes;
+    evictToBudget();
+}
+
+bool AssetCache::makeKey(const std::string& path, int width, int height, ColorMode mode, Key* key) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    key->path = path;
+    key->width = width;
+    key->height = height;
+    key->mode = mode;
+    key->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+std::shared_ptr<const FrameStore> AssetCache::find(const std::string& path, int width, int height,
+                                                   ColorMode mode) {
+    Key key;
+    if (!makeKey(path, width, height, mode, &key)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        misses++;
+        return nullptr;
+    }
+
+    // Move to the front of the LRU list
+    lru.splice(lru.begin(), lru, it->second);
+    hits++;
+    return it->second->frames;
+}
+
+void AssetCache::insert(const std::string& path, int width, int height,
+                        const std::shared_ptr<const FrameStore>& frames) {
+    if (!frames) return;
+
+    Key key;
+    if (!makeKey(path, width, height, frames->colorMode(), &key)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (frames->memoryBytes() > budget_bytes) {
+        std::cout << "AssetCache: " << path << " (" << frames->memoryBytes() / 1024
+                  << " KB) exceeds cache budget, not cached" << std::endl;
+        return;
+    }
+
+    auto existing = index.find(key);
+    if (existing != index.end()) {
+        used_bytes -= existing->second->frames->memoryBytes();
+        lru.erase(existing->second);
+        index.erase(existing);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.frames = frames;
+    lru.push_front(entry);
+    index[key] = lru.begin();
+    used_bytes += frames->memoryBytes();
+
+    evictToBudget();
+}
+
+void AssetCache::evictToBudget() {
+    while (used_bytes > budget_bytes && !lru.empty()) {
+        Entry& victim = lru.back();
+        std::cout << "AssetCache: evicting " << victim.key.path << " " << victim.key.width
+                  << "x" << victim.key.height << std::endl;
+        used_bytes -= victim.frames->memoryBytes();
+        index.erase(victim.key);
+        lru.pop_back();
+    }
+}
+
+size_t AssetCache::entryCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lru.size();
+}
+
+size_t AssetCache::memoryBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used_bytes;
+}
+
+uint64_t AssetCache::hitCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+uint64_t AssetCache::missCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
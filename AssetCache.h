@@ -0,0 +1,71 @@
+#pragma once
+
+#include "FrameStore.h"
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Process-wide cache of decoded, scaled GIF frame sets.
+// Keyed by (path, target width, target height, colour mode, file mtime) so an edited file
+// is decoded again. Elements showing the same asset share one FrameStore.
+// Least recently used entries are evicted once the memory budget is exceeded.
+// Safe to use from the loader thread and the render thread.
+class AssetCache {
+public:
+    static AssetCache& instance();
+
+    // Memory budget in bytes for cached frame data (0 disables caching)
+    void setBudget(size_t bytes);
+
+    // Returns the cached frames or nullptr on a miss
+    std::shared_ptr<const FrameStore> find(const std::string& path, int width, int height,
+                                           ColorMode mode);
+
+    // Store frames decoded for (path, width, height, frames->colorMode())
+    void insert(const std::string& path, int width, int height,
+                const std::shared_ptr<const FrameStore>& frames);
+
+    // Statistics
+    size_t entryCount();
+    size_t memoryBytes();
+    uint64_t hitCount();
+    uint64_t missCount();
+
+private:
+    struct Key {
+        std::string path;
+        int width;
+        int height;
+        ColorMode mode;
+        int64_t mtime_ns;
+
+        bool operator<(const Key& other) const {
+            if (path != other.path) return path < other.path;
+            if (width != other.width) return width < other.width;
+            if (height != other.height) return height < other.height;
+            if (mode != other.mode) return mode < other.mode;
+            return mtime_ns < other.mtime_ns;
+        }
+    };
+
+    struct Entry {
+        Key key;
+        std::shared_ptr<const FrameStore> frames;
+    };
+
+    AssetCache();
+
+    static bool makeKey(const std::string& path, int width, int height, ColorMode mode, Key* key);
+    void evictToBudget();  // Caller holds mutex
+
+    std::mutex mutex;
+    std::list<Entry> lru;  // Front = most recently used
+    std::map<Key, std::list<Entry>::iterator> index;
+    size_t budget_bytes;
+    size_t used_bytes;
+    uint64_t hits;
+    uint64_t misses;
+};
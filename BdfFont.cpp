@@ -1,149 +1,721 @@
 #include "BdfFont.h"
-#include <fstream>
-#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
 #include <iostream>
-#include <iomanip>
+#include <algorithm>
+#include <utility>
 
-BdfFont::BdfFont() : char_width(5), char_height(7), font_ascent(7), font_descent(0) {
+// Storage block layout, one allocation per font:
+//   BdfChar    glyphs[glyph_count]
+//   SparseSlot sparse[sparse_size]
+//   uint8_t    atlas[]               (64-byte aligned)
+// Everything is addressed by offsets within the block.
+static const size_t STORAGE_ALIGN = 64;
+
+// Compiled font file layout (host byte order, built on the target by
+// liv-fontc; mapped read-only and used in place):
+//   FontFileHeader
+//   uint16_t dense_index[DENSE_GLYPHS]
+//   padding up to data_offset (STORAGE_ALIGN)
+//   the storage block above, data_size bytes
+struct FontFileHeader {
+    char magic[4];           // "LIVB"
+    uint32_t version;
+    uint32_t glyph_size;     // sizeof(BdfChar) of the writer
+    uint32_t dense_glyphs;   // BdfFont::DENSE_GLYPHS of the writer
+    uint32_t glyph_count;
+    uint32_t sparse_size;
+    int32_t sparse_shift;
+    int32_t char_width;
+    int32_t char_height;
+    int32_t font_ascent;
+    int32_t font_descent;
+    uint32_t reserved;
+    uint64_t sparse_offset;  // Within the block
+    uint64_t atlas_offset;   // Within the block
+    uint64_t data_offset;    // Start of the block in the file
+    uint64_t data_size;
+};
+
+static const char FONT_FILE_MAGIC[4] = {'L', 'I', 'V', 'B'};
+static const uint32_t FONT_FILE_VERSION = 1;
+static const char FONT_FILE_SUFFIX[] = ".livfont";
+
+// Definitions of the in-class constants (std::fill / std::min take them by reference)
+const uint32_t BdfFont::DENSE_GLYPHS;
+const int16_t BdfFont::GLYPH_UNLOADED;
+const uint16_t BdfFont::NO_GLYPH;
+const uint32_t BdfFont::NO_ENCODING;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+BdfFont::BdfFont() : storage(nullptr), mapped(nullptr), mapped_size(0),
+    storage_size(0), glyphs(nullptr), glyph_count(0),
+    sparse(nullptr), sparse_size(0), sparse_shift(32), atlas(nullptr),
+    lazy_fd(-1), lazy_atlas(nullptr), lazy_atlas_size(0), lazy_atlas_capacity(0),
+    char_width(5), char_height(7), font_ascent(7), font_descent(0) {
+    std::fill(dense_index, dense_index + DENSE_GLYPHS, NO_GLYPH);
 }
 
 BdfFont::~BdfFont() {
+    release();
+}
+
+BdfFont::BdfFont(BdfFont&& other) : storage(nullptr), mapped(nullptr), lazy_fd(-1), lazy_atlas(nullptr) {
+    *this = std::move(other);
+}
+
+BdfFont& BdfFont::operator=(BdfFont&& other) {
+    if (this != &other) {
+        release();
+        storage = other.storage;
+        mapped = other.mapped;
+        mapped_size = other.mapped_size;
+        storage_size = other.storage_size;
+        glyphs = other.glyphs;
+        glyph_count = other.glyph_count;
+        sparse = other.sparse;
+        sparse_size = other.sparse_size;
+        sparse_shift = other.sparse_shift;
+        atlas = other.atlas;
+        lazy_fd = other.lazy_fd;
+        lazy_offsets.swap(other.lazy_offsets);
+        lazy_atlas = other.lazy_atlas;  // Same buffer, so atlas stays valid
+        lazy_atlas_size = other.lazy_atlas_size;
+        lazy_atlas_capacity = other.lazy_atlas_capacity;
+        std::copy(other.dense_index, other.dense_index + DENSE_GLYPHS, dense_index);
+        char_width = other.char_width;
+        char_height = other.char_height;
+        font_ascent = other.font_ascent;
+        font_descent = other.font_descent;
+        
+        // other keeps its metrics but no glyphs
+        other.storage = nullptr;
+        other.mapped = nullptr;
+        other.lazy_fd = -1;
+        other.lazy_atlas = nullptr;
+        other.release();
+    }
+    return *this;
+}
+
+void BdfFont::release() {
+    free(storage);
+    storage = nullptr;
+    if (mapped) {
+        munmap(mapped, mapped_size);
+    }
+    mapped = nullptr;
+    mapped_size = 0;
+    if (lazy_fd >= 0) {
+        close(lazy_fd);
+    }
+    lazy_fd = -1;
+    std::vector<uint32_t>().swap(lazy_offsets);
+    free(lazy_atlas);
+    lazy_atlas = nullptr;
+    lazy_atlas_size = 0;
+    lazy_atlas_capacity = 0;
+    storage_size = 0;
+    glyphs = nullptr;
+    glyph_count = 0;
+    sparse = nullptr;
+    sparse_size = 0;
+    sparse_shift = 32;
+    atlas = nullptr;
+    std::fill(dense_index, dense_index + DENSE_GLYPHS, NO_GLYPH);
+}
+
+// Line cursor over the mapped file: lines and their arguments are pointer
+// ranges into the mapping, nothing is copied
+struct BdfReader {
+    const char* pos;
+    const char* end;
+    const char* line;       // Current line, without its newline
+    const char* line_end;
+    
+    BdfReader(const char* begin, const char* end) : pos(begin), end(end), line(begin), line_end(begin) {}
+    
+    bool nextLine() {
+        if (pos >= end) return false;
+        line = pos;
+        const char* newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        line_end = newline ? newline : end;
+        pos = newline ? newline + 1 : end;
+        return true;
+    }
+    
+    // Skip to just past the next ENDCHAR line (the end of the file if there
+    // is none), without splitting the lines in between
+    void skipToEndChar() {
+        static const char END_CHAR[] = "\nENDCHAR";
+        const char* from = pos > line ? pos - 1 : pos;  // Newline ending the current line
+        const char* found = static_cast<const char*>(memmem(from, end - from, END_CHAR, sizeof(END_CHAR) - 1));
+        if (!found) {
+            pos = end;
+            return;
+        }
+        const char* newline = static_cast<const char*>(memchr(found + 1, '\n', end - found - 1));
+        pos = newline ? newline + 1 : end;
+    }
+    
+    // The line starts with word as a whole token; *args = what follows it
+    bool keyword(const char* word, const char** args) const {
+        const size_t length = strlen(word);
+        if ((size_t)(line_end - line) < length || memcmp(line, word, length) != 0) return false;
+        const char* after = line + length;
+        if (after != line_end && !isSpace(*after)) return false;
+        *args = after;
+        return true;
+    }
+    
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+    
+    // Next decimal integer on the line; false (value untouched) if there is none
+    bool parseInt(const char** cursor, long* value) const {
+        const char* p = *cursor;
+        while (p < line_end && isSpace(*p)) p++;
+        bool negative = false;
+        if (p < line_end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+        if (p == line_end || *p < '0' || *p > '9') return false;
+        
+        long result = 0;
+        while (p < line_end && *p >= '0' && *p <= '9') {
+            if (result < 100000000000L) result = result * 10 + (*p - '0');
+            p++;
+        }
+        *value = negative ? -result : result;
+        *cursor = p;
+        return true;
+    }
+};
+
+namespace {
+
+// Read-only private mapping of a whole open file; the fd stays the caller's
+class MappedFile {
+public:
+    explicit MappedFile(int fd) : data(nullptr), size(0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            if (st.st_size == 0) {
+                data = "";  // Nothing to map, but the file is there
+            } else {
+                void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping != MAP_FAILED) {
+                    data = static_cast<const char*>(mapping);
+                    size = st.st_size;
+                }
+            }
+        }
+    }
+    ~MappedFile() {
+        if (size > 0) munmap(const_cast<char*>(data), size);
+    }
+    
+    const char* data;  // nullptr if the file could not be opened or mapped
+    size_t size;
+    
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;  // Lower case
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return 0;
+}
+
+int16_t clampInt16(long value) {
+    return (int16_t)std::max(-32768L, std::min(32767L, value));
+}
+
+}  // namespace
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string BdfFont::compiledPath(const std::string& bdf_path) {
+    if (endsWith(bdf_path, ".bdf")) {
+        return bdf_path.substr(0, bdf_path.size() - 4) + FONT_FILE_SUFFIX;
+    }
+    return bdf_path + FONT_FILE_SUFFIX;
 }
 
 bool BdfFont::loadFromFile(const std::string& filename) {
-    return parseBdfFile(filename);
+    if (endsWith(filename, FONT_FILE_SUFFIX)) {
+        return mapCompiled(filename);
+    }
+    
+    // A compiled font not newer than its BDF file is stale (font edited
+    // since liv-fontc ran) and ignored; without the BDF file it is used as is
+    const std::string compiled = compiledPath(filename);
+    struct stat bdf_st, compiled_st;
+    if (stat(compiled.c_str(), &compiled_st) == 0) {
+        const bool fresh = stat(filename.c_str(), &bdf_st) != 0 ||
+                           compiled_st.st_mtim.tv_sec > bdf_st.st_mtim.tv_sec ||
+                           (compiled_st.st_mtim.tv_sec == bdf_st.st_mtim.tv_sec &&
+                            compiled_st.st_mtim.tv_nsec > bdf_st.st_mtim.tv_nsec);
+        if (fresh && mapCompiled(compiled)) {
+            return true;
+        }
+    }
+    return loadBdf(filename, true);
+}
+
+bool BdfFont::loadBdf(const std::string& filename, bool lazy) {
+    const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open BDF file: " << filename << std::endl;
+        return false;
+    }
+    
+    std::vector<BdfChar> parsed;
+    std::vector<uint8_t> bitmaps;
+    std::vector<uint32_t> offsets;
+    bool ok = false;
+    {
+        MappedFile file(fd);
+        if (file.data) {
+            indexBdf(file.data, file.size, &parsed);
+            if (lazy) {
+                // A glyph's text runs from its STARTCHAR to the next one's
+                offsets.reserve(parsed.size() + 1);
+                for (BdfChar& glyph : parsed) {
+                    offsets.push_back(glyph.atlas_offset);
+                    glyph.atlas_offset = 0;
+                }
+                offsets.push_back((uint32_t)file.size);
+            } else {
+                // The atlas cannot hold more bytes than half the file's hex digits
+                // plus blank cells; sized once from the bounding box
+                const size_t cell = (size_t)((std::max(char_width, 0) + 7) / 8) * std::max(char_height, 0);
+                bitmaps.reserve(std::min(parsed.size() * cell, file.size / 2));
+                for (BdfChar& glyph : parsed) {
+                    glyph = parseChar(file.data, file.size, glyph.atlas_offset, &bitmaps);
+                }
+            }
+            ok = buildStorage(parsed, bitmaps);
+        } else {
+            std::cerr << "Failed to map BDF file: " << filename << std::endl;
+        }
+    }
+    
+    if (!ok || !lazy) {
+        close(fd);
+    }
+    if (!ok) {
+        return false;
+    }
+    
+    if (lazy) {
+        lazy_fd = fd;
+        lazy_offsets.swap(offsets);
+        std::cout << "Indexed " << glyph_count << " characters from BDF file" << std::endl;
+    } else {
+        std::cout << "Loaded " << glyph_count << " characters from BDF file" << std::endl;
+    }
+    return true;
+}
+
+const BdfChar* BdfFont::loadGlyph(const BdfChar* glyph) const {
+    const size_t index = glyph - glyphs;
+    const uint32_t begin = lazy_offsets[index];
+    const uint32_t end = lazy_offsets[index + 1];
+    lazy_text.resize(end - begin);
+    ssize_t length = lazy_text.empty() ? 0 : pread(lazy_fd, lazy_text.data(), lazy_text.size(), begin);
+    if (length < 0) {
+        length = 0;  // Read error: the glyph draws blank
+    }
+    
+    lazy_bitmap.clear();
+    BdfChar loaded = parseChar(lazy_text.data(), (size_t)length, 0, &lazy_bitmap);
+    loaded.encoding = glyph->encoding;  // Stays where the index put it, whatever the file holds now
+    if (growLazyAtlas(lazy_atlas_size + lazy_bitmap.size())) {
+        std::copy(lazy_bitmap.begin(), lazy_bitmap.end(), lazy_atlas + lazy_atlas_size);
+        loaded.atlas_offset = (uint32_t)lazy_atlas_size;
+        lazy_atlas_size += lazy_bitmap.size();
+        atlas = lazy_atlas;
+    } else {
+        loaded.width = 0;
+        loaded.height = 0;
+        loaded.atlas_offset = 0;
+    }
+    
+    // The glyph table of a lazy font is the allocated storage block (never
+    // a read-only mapping), so the entry can be filled in place
+    BdfChar* entry = const_cast<BdfChar*>(glyph);
+    *entry = loaded;
+    return entry;
 }
 
-const BdfChar* BdfFont::getChar(uint32_t encoding) const {
-    auto it = chars.find(encoding);
-    if (it != chars.end()) {
-        return &it->second;
+bool BdfFont::growLazyAtlas(size_t needed) const {
+    if (needed <= lazy_atlas_capacity) {
+        return true;
+    }
+    
+    // Doubling, in whole STORAGE_ALIGN units like the storage block
+    const size_t capacity = alignUp(std::max(needed, std::max(lazy_atlas_capacity * 2, STORAGE_ALIGN * 16)),
+                                    STORAGE_ALIGN);
+    void* grown = nullptr;
+    if (posix_memalign(&grown, STORAGE_ALIGN, capacity) != 0) {
+        std::cerr << "Out of memory for BDF glyph atlas (" << capacity << " bytes)" << std::endl;
+        return false;
+    }
+    if (lazy_atlas_size > 0) {
+        memcpy(grown, lazy_atlas, lazy_atlas_size);
+    }
+    free(lazy_atlas);
+    lazy_atlas = static_cast<uint8_t*>(grown);
+    lazy_atlas_capacity = capacity;
+    return true;
+}
+
+bool BdfFont::buildStorage(const std::vector<BdfChar>& parsed, const std::vector<uint8_t>& bitmaps) {
+    release();
+    
+    // Indices are 16-bit; no font in fonts/ comes close
+    size_t count = parsed.size();
+    if (count >= NO_GLYPH) {
+        std::cerr << "BDF font has " << count << " glyphs, keeping the first "
+                  << (NO_GLYPH - 1) << std::endl;
+        count = NO_GLYPH - 1;
+    }
+    
+    size_t sparse_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (parsed[i].encoding >= DENSE_GLYPHS) sparse_count++;
+    }
+    
+    // Hash at most half full, so probe sequences stay short
+    int bits = 1;
+    while ((size_t(1) << bits) < sparse_count * 2) {
+        bits++;
+    }
+    
+    const size_t sparse_offset = count * sizeof(BdfChar);
+    const size_t atlas_offset = alignUp(sparse_offset + (size_t(1) << bits) * sizeof(SparseSlot), STORAGE_ALIGN);
+    const size_t total = alignUp(atlas_offset + bitmaps.size(), STORAGE_ALIGN);
+    
+    void* block = nullptr;
+    if (posix_memalign(&block, STORAGE_ALIGN, total) != 0) {
+        std::cerr << "Out of memory for BDF font (" << total << " bytes)" << std::endl;
+        return false;
+    }
+    storage = static_cast<uint8_t*>(block);
+    storage_size = total;
+    
+    BdfChar* glyph_table = reinterpret_cast<BdfChar*>(storage);
+    std::copy(parsed.begin(), parsed.begin() + count, glyph_table);
+    glyphs = glyph_table;
+    glyph_count = (uint32_t)count;
+    
+    SparseSlot* slots = reinterpret_cast<SparseSlot*>(storage + sparse_offset);
+    sparse_size = 1u << bits;
+    sparse_shift = 32 - bits;
+    std::fill(slots, slots + sparse_size, SparseSlot{NO_ENCODING, 0});
+    sparse = slots;
+    
+    uint8_t* atlas_bytes = storage + atlas_offset;
+    std::copy(bitmaps.begin(), bitmaps.end(), atlas_bytes);
+    std::fill(atlas_bytes + bitmaps.size(), storage + total, 0);
+    atlas = atlas_bytes;
+    
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t encoding = glyphs[i].encoding;
+        if (encoding < DENSE_GLYPHS) {
+            dense_index[encoding] = (uint16_t)i;  // Duplicates: the last one wins
+            continue;
+        }
+        
+        uint32_t slot = sparseHash(encoding, sparse_shift);
+        while (slots[slot].encoding != NO_ENCODING && slots[slot].encoding != encoding) {
+            slot = (slot + 1) & (sparse_size - 1);
+        }
+        slots[slot].encoding = encoding;
+        slots[slot].index = (uint32_t)i;
+    }
+    return true;
+}
+
+const BdfChar* BdfFont::findSparse(uint32_t encoding) const {
+    if (sparse_size == 0 || encoding == NO_ENCODING) return nullptr;
+    
+    const uint32_t mask = sparse_size - 1;
+    uint32_t slot = sparseHash(encoding, sparse_shift);
+    while (sparse[slot].encoding != NO_ENCODING) {
+        if (sparse[slot].encoding == encoding) {
+            return &glyphs[sparse[slot].index];
+        }
+        slot = (slot + 1) & mask;
     }
     return nullptr;
 }
 
-bool BdfFont::parseBdfFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open BDF file: " << filename << std::endl;
+bool BdfFont::mapCompiled(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FontFileHeader) + sizeof(dense_index)) {
+        close(fd);
+        return false;
+    }
+    
+    // Shared, read-only: every screen process using the font maps the same pages
+    const size_t file_size = st.st_size;
+    void* data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    
+    FontFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FONT_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FONT_FILE_VERSION || header.glyph_size != sizeof(BdfChar) ||
+        header.dense_glyphs != DENSE_GLYPHS) {
+        std::cerr << "Font file " << path << " has wrong format, ignoring" << std::endl;
+        munmap(data, file_size);
         return false;
     }
     
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.find("FONTBOUNDINGBOX") == 0) {
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token >> char_width >> char_height;
+    // Drawing indexes glyph bitmaps unchecked, so the whole file is checked
+    // once here: header offsets, every index entry and every glyph's cell
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    const uint8_t* block = base + header.data_offset;
+    const uint32_t count = header.glyph_count;
+    const uint32_t slot_count = header.sparse_size;
+    bool valid = count < NO_GLYPH && slot_count > 0 && (slot_count & (slot_count - 1)) == 0 &&
+                 header.sparse_shift == 32 - __builtin_ctz(slot_count) &&
+                 header.data_offset % STORAGE_ALIGN == 0 &&
+                 header.data_offset >= sizeof(header) + sizeof(dense_index) &&
+                 header.data_offset <= file_size && header.data_size <= file_size - header.data_offset &&
+                 header.sparse_offset == (uint64_t)count * sizeof(BdfChar) &&
+                 header.atlas_offset == alignUp(header.sparse_offset + (uint64_t)slot_count * sizeof(SparseSlot),
+                                                STORAGE_ALIGN) &&
+                 header.atlas_offset <= header.data_size;
+    
+    uint16_t index[DENSE_GLYPHS];
+    memcpy(index, base + sizeof(header), sizeof(index));
+    for (uint32_t i = 0; valid && i < DENSE_GLYPHS; i++) {
+        valid = index[i] == NO_GLYPH || index[i] < count;
+    }
+    const BdfChar* glyph_table = reinterpret_cast<const BdfChar*>(block);
+    const uint64_t atlas_size = valid ? header.data_size - header.atlas_offset : 0;
+    for (uint32_t i = 0; valid && i < count; i++) {
+        const BdfChar& glyph = glyph_table[i];
+        valid = glyph.width >= 0 && glyph.height >= 0 &&
+                glyph.atlas_offset + (uint64_t)((glyph.width + 7) / 8) * glyph.height <= atlas_size;
+    }
+    const SparseSlot* slots = reinterpret_cast<const SparseSlot*>(block + (valid ? header.sparse_offset : 0));
+    for (uint32_t i = 0; valid && i < slot_count; i++) {
+        valid = slots[i].encoding == NO_ENCODING || slots[i].index < count;
+    }
+    if (!valid) {
+        std::cerr << "Font file " << path << " is truncated or corrupt, ignoring" << std::endl;
+        munmap(data, file_size);
+        return false;
+    }
+    
+    release();
+    mapped = data;
+    mapped_size = file_size;
+    storage_size = header.data_size;
+    glyphs = glyph_table;
+    glyph_count = count;
+    sparse = slots;
+    sparse_size = slot_count;
+    sparse_shift = header.sparse_shift;
+    atlas = block + header.atlas_offset;
+    std::copy(index, index + DENSE_GLYPHS, dense_index);
+    char_width = header.char_width;
+    char_height = header.char_height;
+    font_ascent = header.font_ascent;
+    font_descent = header.font_descent;
+    
+    std::cout << "BdfFont: mapped " << path << " (" << count << " characters)" << std::endl;
+    return true;
+}
+
+bool BdfFont::writeCompiled(const std::string& path) const {
+    if (!glyphs || lazy_fd >= 0) return false;
+    
+    FontFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FONT_FILE_MAGIC, sizeof(header.magic));
+    header.version = FONT_FILE_VERSION;
+    header.glyph_size = sizeof(BdfChar);
+    header.dense_glyphs = DENSE_GLYPHS;
+    header.glyph_count = glyph_count;
+    header.sparse_size = sparse_size;
+    header.sparse_shift = sparse_shift;
+    header.char_width = char_width;
+    header.char_height = char_height;
+    header.font_ascent = font_ascent;
+    header.font_descent = font_descent;
+    header.sparse_offset = reinterpret_cast<const uint8_t*>(sparse) - reinterpret_cast<const uint8_t*>(glyphs);
+    header.atlas_offset = atlas - reinterpret_cast<const uint8_t*>(glyphs);
+    header.data_offset = alignUp(sizeof(header) + sizeof(dense_index), STORAGE_ALIGN);
+    header.data_size = storage_size;
+    
+    // Temporary file and rename, so a process loading the font never maps
+    // a half written file
+    const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (!file) return false;
+    
+    static const uint8_t padding[STORAGE_ALIGN] = {0};
+    const size_t table_end = sizeof(header) + sizeof(dense_index);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(dense_index, sizeof(dense_index), 1, file) == 1 &&
+              (header.data_offset == table_end ||
+               fwrite(padding, header.data_offset - table_end, 1, file) == 1) &&
+              fwrite(glyphs, 1, storage_size, file) == storage_size;
+    
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(tmp_path.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        unlink(tmp_path.c_str());
+        std::cerr << "Failed to write font file " << path << std::endl;
+    }
+    return ok;
+}
+
+
+void BdfFont::indexBdf(const char* text, size_t size, std::vector<BdfChar>* index) {
+    BdfReader reader(text, text + size);
+    const char* args;
+    long value;
+    while (reader.nextLine()) {
+        if (reader.keyword("FONTBOUNDINGBOX", &args)) {
+            if (reader.parseInt(&args, &value)) char_width = (int)value;
+            if (reader.parseInt(&args, &value)) char_height = (int)value;
             std::cout << "Font bounding box: " << char_width << "x" << char_height << std::endl;
         }
-        else if (line.find("FONT_ASCENT") == 0) {
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token >> font_ascent;
+        else if (reader.keyword("FONT_ASCENT", &args)) {
+            if (reader.parseInt(&args, &value)) font_ascent = (int)value;
             std::cout << "Font ascent: " << font_ascent << std::endl;
         }
-        else if (line.find("FONT_DESCENT") == 0) {
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token >> font_descent;
+        else if (reader.keyword("FONT_DESCENT", &args)) {
+            if (reader.parseInt(&args, &value)) font_descent = (int)value;
             std::cout << "Font descent: " << font_descent << std::endl;
         }
-        else if (line.find("STARTCHAR") == 0) {
-            // Parse character
-            BdfChar ch = parseChar(file);
-            if (ch.encoding != 0xFFFFFFFF) { // Valid character
-                chars[ch.encoding] = ch;
+        else if (reader.keyword("CHARS", &args)) {
+            if (reader.parseInt(&args, &value) && value > 0 && value < NO_GLYPH) {
+                index->reserve(value);
+            }
+        }
+        else if (reader.keyword("STARTCHAR", &args)) {
+            // Only as far as ENCODING, then on to the next glyph without
+            // looking at its metrics or bitmap
+            BdfChar glyph = BdfChar();
+            glyph.encoding = NO_ENCODING;
+            glyph.width = GLYPH_UNLOADED;
+            glyph.atlas_offset = (uint32_t)(reader.line - text);
+            while (reader.nextLine()) {
+                if (reader.keyword("ENCODING", &args)) {
+                    // -1 = no standard encoding, skipped like a missing ENCODING
+                    if (reader.parseInt(&args, &value) && value >= 0 && value < (long)NO_ENCODING) {
+                        glyph.encoding = (uint32_t)value;
+                    }
+                    reader.skipToEndChar();
+                    break;
+                }
+                if (reader.keyword("BITMAP", &args)) {
+                    reader.skipToEndChar();
+                    break;
+                }
+                if (reader.keyword("ENDCHAR", &args)) {
+                    break;
+                }
+            }
+            if (glyph.encoding != NO_ENCODING) {
+                index->push_back(glyph);
             }
         }
     }
-    
-    file.close();
-    std::cout << "Loaded " << chars.size() << " characters from BDF file" << std::endl;
-    return true;
 }
 
-BdfChar BdfFont::parseChar(std::ifstream& file) {
-    BdfChar ch;
-    ch.encoding = 0xFFFFFFFF; // Invalid encoding
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.find("ENCODING") == 0) {
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token >> ch.encoding;
-        }
-        else if (line.find("DWIDTH") == 0) {
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token >> ch.dwidth;  // DWIDTH determines character advancement
-        }
-        else if (line.find("BBX") == 0) {
-            std::istringstream iss(line);
-            std::string token;
-            int16_t x_offset, y_offset;
-            iss >> token >> ch.width >> ch.height >> x_offset >> y_offset;  // BBX determines bitmap size
-            ch.x_offset = x_offset;
-            ch.y_offset = y_offset;
-        }
-        else if (line.find("BITMAP") == 0) {
-            ch.bitmap = parseBitmap(file, ch.width, ch.height);
+BdfChar BdfFont::parseChar(const char* text, size_t size, uint32_t offset, std::vector<uint8_t>* bitmaps) {
+    BdfReader reader(text + offset, text + size);
+    reader.nextLine();  // STARTCHAR
+    
+    BdfChar ch = BdfChar();
+    ch.encoding = NO_ENCODING;
+    ch.atlas_offset = (uint32_t)bitmaps->size();
+    
+    const char* args;
+    long value;
+    while (reader.nextLine()) {
+        if (reader.keyword("ENCODING", &args)) {
+            if (reader.parseInt(&args, &value) && value >= 0 && value < (long)NO_ENCODING) {
+                ch.encoding = (uint32_t)value;
+            }
+        }
+        else if (reader.keyword("DWIDTH", &args)) {
+            if (reader.parseInt(&args, &value)) ch.dwidth = clampInt16(value);  // Character advancement
+        }
+        else if (reader.keyword("BBX", &args)) {
+            // Bitmap size and offset
+            if (reader.parseInt(&args, &value)) ch.width = clampInt16(value);
+            if (reader.parseInt(&args, &value)) ch.height = clampInt16(value);
+            if (reader.parseInt(&args, &value)) ch.x_offset = clampInt16(value);
+            if (reader.parseInt(&args, &value)) ch.y_offset = clampInt16(value);
+        }
+        else if (reader.keyword("BITMAP", &args)) {
+            parseBitmap(reader, ch.width, ch.height, bitmaps);
             break;
         }
-        else if (line.find("ENDCHAR") == 0) {
+        else if (reader.keyword("ENDCHAR", &args)) {
             break;
         }
     }
     
-    // Debug: print character info for letters L, E, D
-    if (ch.encoding == 'L' || ch.encoding == 'E' || ch.encoding == 'D') {
-        std::cout << "BDF: Parsed char '" << (char)ch.encoding << "' (ASCII " << ch.encoding 
-                  << ") size " << ch.width << "x" << ch.height 
-                  << " offset (" << ch.x_offset << "," << ch.y_offset << ")"
-                  << " dwidth=" << ch.dwidth
-                  << " bitmap size " << ch.bitmap.size() << " bytes" << std::endl;
-        
-        // Print first few bytes of bitmap
-        for (size_t i = 0; i < std::min(ch.bitmap.size(), size_t(5)); i++) {
-            std::cout << "  bitmap[" << i << "] = 0x" << std::hex << (int)ch.bitmap[i] << std::dec << std::endl;
-        }
+    // Every glyph owns exactly bytes_per_row * height atlas bytes, so drawing
+    // can index its bitmap without bounds checks (a glyph without a BITMAP
+    // section draws blank)
+    if (ch.width < 0 || ch.height < 0) {
+        ch.width = 0;
+        ch.height = 0;
     }
+    bitmaps->resize(ch.atlas_offset + (size_t)((ch.width + 7) / 8) * ch.height, 0);
     
     return ch;
 }
 
-std::vector<uint8_t> BdfFont::parseBitmap(std::ifstream& file, int width, int height) {
-    std::vector<uint8_t> bitmap;
-    std::string line;
-    
-    // Calculate bytes per row (width in bits / 8, rounded up)
-    int bytes_per_row = (width + 7) / 8;
-    
-    for (int row = 0; row < height; row++) {
-        if (std::getline(file, line)) {
-            // Parse hex string
-            std::istringstream iss(line);
-            std::string hex_str;
-            iss >> hex_str;
-            
-            // Convert hex string to bytes
-            for (int byte = 0; byte < bytes_per_row; byte++) {
-                if (static_cast<size_t>(byte * 2 + 1) < hex_str.length()) {
-                    std::string byte_str = hex_str.substr(byte * 2, 2);
-                    uint8_t byte_val = static_cast<uint8_t>(std::stoul(byte_str, nullptr, 16));
-                    bitmap.push_back(byte_val);
-                } else {
-                    bitmap.push_back(0);
-                }
-            }
-        } else {
-            // Fill with zeros if line is missing
-            for (int byte = 0; byte < bytes_per_row; byte++) {
-                bitmap.push_back(0);
-            }
+void BdfFont::parseBitmap(BdfReader& reader, int width, int height, std::vector<uint8_t>* bitmaps) {
+    // One line of hex digits per row, (width + 7) / 8 bytes, MSB first;
+    // short or missing rows are padded with zeros
+    const int bytes_per_row = width > 0 ? (width + 7) / 8 : 0;
+    const size_t start = bitmaps->size();
+    bitmaps->resize(start + (size_t)bytes_per_row * std::max(height, 0), 0);
+    uint8_t* out = bitmaps->data() + start;
+    
+    for (int row = 0; row < height && reader.nextLine(); row++) {
+        const char* hex = reader.line;
+        while (hex < reader.line_end && BdfReader::isSpace(*hex)) hex++;
+        const char* hex_end = hex;
+        while (hex_end < reader.line_end && !BdfReader::isSpace(*hex_end)) hex_end++;
+        
+        const long bytes = std::min<long>(bytes_per_row, (hex_end - hex) / 2);
+        for (long byte = 0; byte < bytes; byte++) {
+            out[byte] = (uint8_t)(hexValue(hex[byte * 2]) << 4 | hexValue(hex[byte * 2 + 1]));
         }
+        out += bytes_per_row;
     }
-    
-    return bitmap;
 }
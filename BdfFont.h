@@ -3,9 +3,13 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <cstdint>
 
+struct BdfReader;
+
+// Glyph metrics; the bitmap is in the font's atlas (BdfFont::glyphBitmap):
+// height rows of (width + 7) / 8 bytes, MSB first. Until a lazily loaded
+// glyph is first looked up, width is BdfFont::GLYPH_UNLOADED.
 struct BdfChar {
     uint32_t encoding;
     int16_t width;          // BBX width (bitmap width)
@@ -13,31 +17,132 @@ struct BdfChar {
     int16_t x_offset;       // BBX x offset
     int16_t y_offset;       // BBX y offset
     int16_t dwidth;         // DWIDTH (advancement width for cursor)
-    std::vector<uint8_t> bitmap;
+    uint32_t atlas_offset;  // Start of the bitmap in the atlas
 };
 
 class BdfFont {
 public:
+    // Glyphs below this code point are found by direct indexing: ASCII,
+    // Latin-1 and Latin Extended-A (Polish letters). Anything above goes
+    // through a small open-addressing hash.
+    static const uint32_t DENSE_GLYPHS = 0x180;
+    static const int16_t GLYPH_UNLOADED = -1;
+    
     BdfFont();
     ~BdfFont();
     
+    // Owns its storage block or mapping: movable (font cache), not copyable
+    BdfFont(BdfFont&& other);
+    BdfFont& operator=(BdfFont&& other);
+    BdfFont(const BdfFont&) = delete;
+    BdfFont& operator=(const BdfFont&) = delete;
+    
+    // Maps the compiled font (compiledPath()) when it exists and is newer
+    // than the BDF file, loads the BDF file lazily otherwise. A .livfont
+    // path is mapped directly.
     bool loadFromFile(const std::string& filename);
-    const BdfChar* getChar(uint32_t encoding) const;
+    
+    // Parses the BDF file. Lazily: only the STARTCHAR offset of each glyph
+    // is indexed and the file stays open; a glyph is read and parsed the
+    // first time getChar() returns it. Otherwise every glyph is parsed now.
+    bool loadBdf(const std::string& filename, bool lazy = false);
+    
+    // Write the loaded font as a compiled font file (via a temporary file
+    // and rename); the file is mapped read-only by loadFromFile() and its
+    // pages are shared by every process using the font. Needs a font
+    // loaded with loadBdf(filename, false).
+    bool writeCompiled(const std::string& path) const;
+    
+    // fonts/5x7.bdf -> fonts/5x7.livfont
+    static std::string compiledPath(const std::string& bdf_path);
+    
+    
+    // Glyph for a Unicode code point, nullptr if the font has none. Loads
+    // the glyph on first use in a lazily loaded font, so like the rest of
+    // BdfFont it is for one thread (the render thread) only.
+    const BdfChar* getChar(uint32_t encoding) const {
+        const BdfChar* glyph;
+        if (encoding < DENSE_GLYPHS) {
+            const uint16_t index = dense_index[encoding];
+            if (index == NO_GLYPH) return nullptr;
+            glyph = &glyphs[index];
+        } else {
+            glyph = findSparse(encoding);
+            if (!glyph) return nullptr;
+        }
+        return glyph->width != GLYPH_UNLOADED ? glyph : loadGlyph(glyph);
+    }
+    
+    // Bitmap rows of a glyph returned by getChar(); valid until the next
+    // getChar() (loading a glyph may grow a lazy font's atlas)
+    const uint8_t* glyphBitmap(const BdfChar* glyph) const { return atlas + glyph->atlas_offset; }
+    
+    size_t glyphCount() const { return glyph_count; }
+    size_t memoryBytes() const {
+        return storage_size + lazy_atlas_capacity + lazy_offsets.capacity() * sizeof(uint32_t);
+    }
+    bool isMapped() const { return mapped != nullptr; }
     int getCharWidth() const { return char_width; }
     int getCharHeight() const { return char_height; }
     int getFontAscent() const { return font_ascent; }
     int getFontDescent() const { return font_descent; }
     
 private:
-    std::map<uint32_t, BdfChar> chars;
+    static const uint16_t NO_GLYPH = 0xFFFF;
+    
+    struct SparseSlot {
+        uint32_t encoding;  // NO_ENCODING = empty
+        uint32_t index;     // Into glyphs
+    };
+    static const uint32_t NO_ENCODING = 0xFFFFFFFF;
+    
+    // Metrics, hash table and glyph atlas share one 64-byte aligned
+    // block (layout in BdfFont.cpp), so a font is a single allocation
+    // however many glyphs it has - or a slice of a compiled font file's
+    // mapping, which has the same layout
+    uint8_t* storage;                   // Allocated block, nullptr when mapped
+    void* mapped;                       // Compiled font file
+    size_t mapped_size;
+    size_t storage_size;                // Size of the block
+    const BdfChar* glyphs;              // In file order, start of the block
+    uint32_t glyph_count;
+    const SparseSlot* sparse;           // Power-of-two size, linear probing
+    uint32_t sparse_size;
+    int sparse_shift;                   // 32 - log2(sparse_size)
+    mutable const uint8_t* atlas;
+    
+    // A lazy font reads glyphs from the BDF file with pread() rather than
+    // through a mapping: a file truncated or rewritten while the font is
+    // in use gives a short read (a blank glyph), never SIGBUS
+    int lazy_fd;                            // -1 = every glyph loaded
+    std::vector<uint32_t> lazy_offsets;     // STARTCHAR of each glyph, then the file size
+    mutable uint8_t* lazy_atlas;            // 64-byte aligned like the block, grows per glyph
+    mutable size_t lazy_atlas_size;
+    mutable size_t lazy_atlas_capacity;
+    mutable std::vector<char> lazy_text;    // Scratch: BDF text of the glyph being loaded
+    mutable std::vector<uint8_t> lazy_bitmap;
+    uint16_t dense_index[DENSE_GLYPHS]; // Code point -> glyphs index, NO_GLYPH = none
     int char_width;
     int char_height;
     int font_ascent;
     int font_descent;
     
-    bool parseBdfFile(const std::string& filename);
-    BdfChar parseChar(std::ifstream& file);
-    std::vector<uint8_t> parseBitmap(std::ifstream& file, int width, int height);
+    void release();
+    bool buildStorage(const std::vector<BdfChar>& parsed, const std::vector<uint8_t>& bitmaps);
+    bool mapCompiled(const std::string& path);
+    const BdfChar* findSparse(uint32_t encoding) const;
+    const BdfChar* loadGlyph(const BdfChar* glyph) const;
+    bool growLazyAtlas(size_t needed) const;
+    static uint32_t sparseHash(uint32_t encoding, int shift) {
+        return (encoding * 0x9E3779B1u) >> shift;  // Fibonacci hashing
+    }
+    
+    // The BDF text is tokenized in place from the mapping, no per-line
+    // allocation. indexBdf reads the font properties and one unloaded
+    // entry per glyph; parseChar parses a glyph from its STARTCHAR offset.
+    void indexBdf(const char* text, size_t size, std::vector<BdfChar>* index);
+    static BdfChar parseChar(const char* text, size_t size, uint32_t offset, std::vector<uint8_t>* bitmaps);
+    static void parseBitmap(BdfReader& reader, int width, int height, std::vector<uint8_t>* bitmaps);
 };
 
 #endif // BDF_FONT_H
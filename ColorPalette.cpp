@@ -0,0 +1,102 @@
+#include "ColorPalette.h"
+#include <climits>
+
+// Initialize color palette
+Color8 ColorPalette::palette[PALETTE_SIZE];
+uint32_t ColorPalette::packed[PALETTE_SIZE];
+bool ColorPalette::initialized = false;
+
+void ColorPalette::initialize() {
+    if (initialized) return;
+    
+    // Create a 256-color palette with good coverage
+    int index = 0;
+    
+    // Basic colors (16 colors)
+    palette[index++] = Color8(0, 0, 0);       // Black
+    palette[index++] = Color8(255, 255, 255); // White
+    palette[index++] = Color8(255, 0, 0);     // Red
+    palette[index++] = Color8(0, 255, 0);     // Green
+    palette[index++] = Color8(0, 0, 255);     // Blue
+    palette[index++] = Color8(255, 255, 0);   // Yellow
+    palette[index++] = Color8(255, 0, 255);   // Magenta
+    palette[index++] = Color8(0, 255, 255);   // Cyan
+    palette[index++] = Color8(128, 128, 128); // Gray
+    palette[index++] = Color8(192, 192, 192); // Light Gray
+    palette[index++] = Color8(64, 64, 64);    // Dark Gray
+    palette[index++] = Color8(255, 128, 0);   // Orange
+    palette[index++] = Color8(128, 0, 128);   // Purple
+    palette[index++] = Color8(0, 128, 0);     // Dark Green
+    palette[index++] = Color8(0, 0, 128);     // Dark Blue
+    palette[index++] = Color8(128, 128, 0);   // Olive
+    
+    // Generate RGB cube (6x6x6 = 216 colors)
+    for (int r = 0; r < 6; r++) {
+        for (int g = 0; g < 6; g++) {
+            for (int b = 0; b < 6; b++) {
+                if (index < PALETTE_SIZE) {
+                    palette[index++] = Color8(
+                        (r * 255) / 5,
+                        (g * 255) / 5,
+                        (b * 255) / 5
+                    );
+                }
+            }
+        }
+    }
+    
+    // Fill remaining slots with grayscale
+    while (index < PALETTE_SIZE) {
+        int gray = (index * 255) / (PALETTE_SIZE - 1);
+        palette[index++] = Color8(gray, gray, gray);
+    }
+    
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        packed[i] = palette[i].r | palette[i].g << 8 | palette[i].b << 16;
+    }
+    
+    initialized = true;
+}
+
+uint8_t ColorPalette::rgbTo8bit(uint8_t r, uint8_t g, uint8_t b) {
+    if (!initialized) initialize();
+    
+    // Find closest color in palette
+    int best_index = 0;
+    int best_distance = INT_MAX;
+    
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        int dr = r - palette[i].r;
+        int dg = g - palette[i].g;
+        int db = b - palette[i].b;
+        int distance = dr*dr + dg*dg + db*db;
+        
+        if (distance < best_distance) {
+            best_distance = distance;
+            best_index = i;
+        }
+    }
+    
+    return best_index;
+}
+
+Color8 ColorPalette::getColor(uint8_t index) {
+    if (!initialized) initialize();
+    if (index >= PALETTE_SIZE) index = 0;
+    return palette[index];
+}
+
+bool parseColorMode(const std::string& name, ColorMode* mode) {
+    if (name == "palette256") {
+        *mode = COLOR_MODE_PALETTE256;
+    } else if (name == "truecolor") {
+        *mode = COLOR_MODE_TRUECOLOR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* colorModeName(ColorMode mode) {
+    return mode == COLOR_MODE_TRUECOLOR ? "truecolor" : "palette256";
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// 8-bit color palette for performance optimization
+struct Color8 {
+    uint8_t r, g, b;
+    Color8(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0) : r(red), g(green), b(blue) {}
+};
+
+// How colours reach the canvas: quantized to the 256-colour palette, or
+// passed through as 24-bit RGB (no palette lookup anywhere)
+enum ColorMode {
+    COLOR_MODE_PALETTE256,
+    COLOR_MODE_TRUECOLOR
+};
+
+// "palette256" / "truecolor"; returns false for an unknown name
+bool parseColorMode(const std::string& name, ColorMode* mode);
+const char* colorModeName(ColorMode mode);
+
+// 8-bit color palette with 256 colors
+class ColorPalette {
+public:
+    static const int PALETTE_SIZE = 256;
+    static Color8 palette[PALETTE_SIZE];
+    static uint32_t packed[PALETTE_SIZE];  // palette as r | g << 8 | b << 16, for RowKernels
+    static bool initialized;
+    
+    // Lookup table for fast RGB to 8-bit conversion, 6 bits per channel
+    // (256 KB): rgbTo8bit() of the colour with the low 2 bits cleared.
+    // Generated at build time by gen-color-lut into ColorLut.cpp.
+    static const uint8_t rgb_lookup[64][64][64];
+    
+    static void initialize();
+    static uint8_t rgbTo8bit(uint8_t r, uint8_t g, uint8_t b);
+    static uint8_t rgbTo8bitFast(uint8_t r, uint8_t g, uint8_t b) {
+        return rgb_lookup[r >> 2][g >> 2][b >> 2];
+    }
+    static Color8 getColor(uint8_t index);
+    
+    // Device colour for an RGB value in the given mode
+    static Color8 mapColor(uint8_t r, uint8_t g, uint8_t b, ColorMode mode) {
+        if (mode == COLOR_MODE_TRUECOLOR) return Color8(r, g, b);
+        return getColor(rgbTo8bitFast(r, g, b));
+    }
+};
@@ -0,0 +1,87 @@
+#include "DamageMap.h"
+#include <algorithm>
+
+void DamageMap::resize(int width, int height) {
+    screen_width = width;
+    screen_height = height;
+    tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    tiles.assign((size_t)tiles_x * tiles_y, 0);
+    dirty_any = false;
+}
+
+void DamageMap::mark(const Rect& rect) {
+    Rect area = rect.intersect(Rect(0, 0, screen_width, screen_height));
+    if (area.empty()) return;
+
+    const int tx0 = area.x / TILE_SIZE;
+    const int ty0 = area.y / TILE_SIZE;
+    const int tx1 = (area.right() - 1) / TILE_SIZE;
+    const int ty1 = (area.bottom() - 1) / TILE_SIZE;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        std::fill(tiles.begin() + ty * tiles_x + tx0, tiles.begin() + ty * tiles_x + tx1 + 1, 1);
+    }
+    dirty_any = true;
+}
+
+void DamageMap::markAll() {
+    std::fill(tiles.begin(), tiles.end(), 1);
+    dirty_any = !tiles.empty();
+}
+
+void DamageMap::merge(const DamageMap& other) {
+    if (!other.dirty_any || other.tiles.size() != tiles.size()) return;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        tiles[i] |= other.tiles[i];
+    }
+    dirty_any = true;
+}
+
+void DamageMap::clear() {
+    std::fill(tiles.begin(), tiles.end(), 0);
+    dirty_any = false;
+}
+
+std::vector<Rect> DamageMap::rects() const {
+    std::vector<Rect> result;
+    if (!dirty_any) return result;
+
+    // Runs that may still grow downwards: index into result
+    std::vector<size_t> open_runs;
+    std::vector<size_t> row_runs;
+    for (int ty = 0; ty < tiles_y; ty++) {
+        row_runs.clear();
+        const uint8_t* row = &tiles[(size_t)ty * tiles_x];
+        int tx = 0;
+        while (tx < tiles_x) {
+            if (!row[tx]) {
+                tx++;
+                continue;
+            }
+            int start = tx;
+            while (tx < tiles_x && row[tx]) tx++;
+
+            Rect run(start * TILE_SIZE, ty * TILE_SIZE,
+                     std::min(tx * TILE_SIZE, screen_width) - start * TILE_SIZE,
+                     std::min((ty + 1) * TILE_SIZE, screen_height) - ty * TILE_SIZE);
+
+            // Extend the rectangle from the row above if it spans the same tiles
+            bool extended = false;
+            for (size_t i = 0; i < open_runs.size(); i++) {
+                Rect& above = result[open_runs[i]];
+                if (above.x == run.x && above.width == run.width && above.bottom() == run.y) {
+                    above.height += run.height;
+                    row_runs.push_back(open_runs[i]);
+                    extended = true;
+                    break;
+                }
+            }
+            if (!extended) {
+                result.push_back(run);
+                row_runs.push_back(result.size() - 1);
+            }
+        }
+        open_runs.swap(row_runs);
+    }
+    return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Surface.h"
+#include <stdint.h>
+#include <vector>
+
+// Per-tile dirty map of the screen. Rendering marks the areas that changed
+// (GIF frame, blink toggle, text update, delete) and the compositor only
+// recomposes and pushes the dirty tiles.
+class DamageMap {
+public:
+    static const int TILE_SIZE = 16;
+
+    DamageMap() : screen_width(0), screen_height(0), tiles_x(0), tiles_y(0), dirty_any(false) {}
+
+    void resize(int width, int height);
+
+    void mark(const Rect& rect);   // Clipped to the screen
+    void markAll();
+    void merge(const DamageMap& other);
+    void clear();
+    bool any() const { return dirty_any; }
+
+    // Screen rectangles covering all dirty tiles: runs of dirty tiles per tile
+    // row, with identical runs on consecutive rows merged into one rectangle
+    std::vector<Rect> rects() const;
+
+private:
+    int screen_width;
+    int screen_height;
+    int tiles_x;
+    int tiles_y;
+    std::vector<uint8_t> tiles;  // 1 = dirty, row-major
+    bool dirty_any;
+};
@@ -0,0 +1,77 @@
+#include "DiskFrameCache.h"
+#include <sys/stat.h>
+#include <errno.h>
+#include <iostream>
+
+std::string DiskFrameCache::cache_dir;
+
+void DiskFrameCache::setDirectory(const std::string& dir) {
+    cache_dir = dir;
+    while (cache_dir.size() > 1 && cache_dir[cache_dir.size() - 1] == '/') {
+        cache_dir.erase(cache_dir.size() - 1);
+    }
+}
+
+std::string DiskFrameCache::pathFor(const std::string& gif_path, int width, int height,
+                                    ColorMode mode) {
+    // anim/2.gif at 192x192 -> <dir>/anim_s2.gif.192x192.frames
+    // (<dir>/anim_s2.gif.192x192.truecolor.frames in true colour mode).
+    // '/' -> "_s" and '_' -> "__" keep names distinct: anim_2.gif is anim__2.gif
+    std::string name;
+    name.reserve(gif_path.size() + 8);
+    for (size_t i = 0; i < gif_path.size(); i++) {
+        if (gif_path[i] == '/') {
+            name += "_s";
+        } else if (gif_path[i] == '_') {
+            name += "__";
+        } else {
+            name += gif_path[i];
+        }
+    }
+    return cache_dir + "/" + name + "." + std::to_string(width) + "x" +
+           std::to_string(height) + (mode == COLOR_MODE_TRUECOLOR ? ".truecolor" : "") + ".frames";
+}
+
+bool DiskFrameCache::sourceInfo(const std::string& gif_path, uint64_t* mtime_ns, uint64_t* size) {
+    struct stat st;
+    if (stat(gif_path.c_str(), &st) != 0) {
+        return false;
+    }
+    *mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    *size = st.st_size;
+    return true;
+}
+
+std::shared_ptr<const FrameStore> DiskFrameCache::load(const std::string& gif_path, int width, int height,
+                                                       ColorMode mode) {
+    if (cache_dir.empty()) return nullptr;
+
+    uint64_t mtime_ns, size;
+    if (!sourceInfo(gif_path, &mtime_ns, &size)) return nullptr;
+
+    std::shared_ptr<const FrameStore> frames =
+        FrameStore::mapFile(pathFor(gif_path, width, height, mode), mtime_ns, size, mode);
+    if (frames) {
+        std::cout << "DiskFrameCache: mapped " << gif_path << " " << width << "x" << height
+                  << " (" << frames->frameCount() << " frames)" << std::endl;
+    }
+    return frames;
+}
+
+bool DiskFrameCache::store(const std::string& gif_path, int width, int height, const FrameStore& frames) {
+    if (cache_dir.empty()) return false;
+
+    uint64_t mtime_ns, size;
+    if (!sourceInfo(gif_path, &mtime_ns, &size)) return false;
+
+    if (mkdir(cache_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "DiskFrameCache: cannot create " << cache_dir << std::endl;
+        return false;
+    }
+
+    const std::string path = pathFor(gif_path, width, height, frames.colorMode());
+    if (!frames.writeFile(path, mtime_ns, size)) return false;
+
+    std::cout << "DiskFrameCache: wrote " << path << std::endl;
+    return true;
+}
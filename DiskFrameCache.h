@@ -0,0 +1,34 @@
+#pragma once
+
+#include "FrameStore.h"
+#include <stdint.h>
+#include <string>
+#include <memory>
+
+// Persistent cache of decoded, scaled GIF frames: one FrameStore frame file
+// per (GIF, target size, colour mode) in a cache directory. Files are validated against
+// the source GIF's mtime and size and are mapped with mmap, so a process
+// start does not have to run GraphicsMagick for assets decoded before.
+// Files are written by the viewer on first load or ahead of time by liv-assetc.
+class DiskFrameCache {
+public:
+    // Directory holding frame files; an empty string disables the cache
+    static void setDirectory(const std::string& dir);
+    static const std::string& directory() { return cache_dir; }
+
+    // Frame file path for (gif_path, width, height, mode)
+    static std::string pathFor(const std::string& gif_path, int width, int height,
+                               ColorMode mode);
+
+    // Map the frame file if it exists and is up to date, nullptr otherwise
+    static std::shared_ptr<const FrameStore> load(const std::string& gif_path, int width, int height,
+                                                  ColorMode mode);
+
+    // Write frames decoded from gif_path at (width, height), in frames.colorMode()
+    static bool store(const std::string& gif_path, int width, int height, const FrameStore& frames);
+
+private:
+    static std::string cache_dir;
+
+    static bool sourceInfo(const std::string& gif_path, uint64_t* mtime_ns, uint64_t* size);
+};
@@ -1,147 +1,58 @@
 #include "DisplayManager.h"
 #include "LedImgViewer.h"
+#include "AssetCache.h"
+#include "RowKernels.h"
+#include "MatrixRenderTarget.h"
+#include "FrameProfiler.h"
+#include "Utf8.h"
 #include <sys/time.h>
+#include <time.h>
 #include <algorithm>
 #include <iostream>
 #include <cstring>
 #include <unistd.h>
+#include <errno.h>
 #include <cstdlib>
 #include <climits>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <signal.h>
+#include <pthread.h>
 
-// Initialize color palette
-Color8 ColorPalette::palette[PALETTE_SIZE];
-bool ColorPalette::initialized = false;
-uint8_t ColorPalette::rgb_lookup[256][256][256];
-bool ColorPalette::lookup_initialized = false;
-
-void ColorPalette::initialize() {
-    if (initialized) return;
-    
-    // Create a 256-color palette with good coverage
-    int index = 0;
-    
-    // Basic colors (16 colors)
-    palette[index++] = Color8(0, 0, 0);       // Black
-    palette[index++] = Color8(255, 255, 255); // White
-    palette[index++] = Color8(255, 0, 0);     // Red
-    palette[index++] = Color8(0, 255, 0);     // Green
-    palette[index++] = Color8(0, 0, 255);     // Blue
-    palette[index++] = Color8(255, 255, 0);   // Yellow
-    palette[index++] = Color8(255, 0, 255);   // Magenta
-    palette[index++] = Color8(0, 255, 255);   // Cyan
-    palette[index++] = Color8(128, 128, 128); // Gray
-    palette[index++] = Color8(192, 192, 192); // Light Gray
-    palette[index++] = Color8(64, 64, 64);    // Dark Gray
-    palette[index++] = Color8(255, 128, 0);   // Orange
-    palette[index++] = Color8(128, 0, 128);   // Purple
-    palette[index++] = Color8(0, 128, 0);     // Dark Green
-    palette[index++] = Color8(0, 0, 128);     // Dark Blue
-    palette[index++] = Color8(128, 128, 0);   // Olive
-    
-    // Generate RGB cube (6x6x6 = 216 colors)
-    for (int r = 0; r < 6; r++) {
-        for (int g = 0; g < 6; g++) {
-            for (int b = 0; b < 6; b++) {
-                if (index < PALETTE_SIZE) {
-                    palette[index++] = Color8(
-                        (r * 255) / 5,
-                        (g * 255) / 5,
-                        (b * 255) / 5
-                    );
-                }
-            }
-        }
-    }
-    
-    // Fill remaining slots with grayscale
-    while (index < PALETTE_SIZE) {
-        int gray = (index * 255) / (PALETTE_SIZE - 1);
-        palette[index++] = Color8(gray, gray, gray);
-    }
-    
-    initialized = true;
-    initializeLookupTable();
-}
-
-void ColorPalette::initializeLookupTable() {
-    if (lookup_initialized) return;
-    
-    std::cout << "Initializing RGB lookup table for fast color conversion..." << std::endl;
-    
-    // Pre-calculate lookup table for all possible RGB combinations
-    for (int r = 0; r < 256; r += 4) {  // Sample every 4th value for memory efficiency
-        for (int g = 0; g < 256; g += 4) {
-            for (int b = 0; b < 256; b += 4) {
-                uint8_t color_index = rgbTo8bit(r, g, b);
-                
-                // Fill 4x4x4 cube around this point
-                for (int dr = 0; dr < 4 && r + dr < 256; dr++) {
-                    for (int dg = 0; dg < 4 && g + dg < 256; dg++) {
-                        for (int db = 0; db < 4 && b + db < 256; db++) {
-                            rgb_lookup[r + dr][g + dg][b + db] = color_index;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    lookup_initialized = true;
-    std::cout << "RGB lookup table initialized" << std::endl;
-}
-
-uint8_t ColorPalette::rgbTo8bit(uint8_t r, uint8_t g, uint8_t b) {
-    if (!initialized) initialize();
-    
-    // Find closest color in palette
-    int best_index = 0;
-    int best_distance = INT_MAX;
-    
-    for (int i = 0; i < PALETTE_SIZE; i++) {
-        int dr = r - palette[i].r;
-        int dg = g - palette[i].g;
-        int db = b - palette[i].b;
-        int distance = dr*dr + dg*dg + db*db;
-        
-        if (distance < best_distance) {
-            best_distance = distance;
-            best_index = i;
-        }
-    }
+DisplayManager::DisplayManager(RenderTarget* target, bool swap_dimensions, uint8_t screen_id,
+                               ColorMode color_mode) 
+    : serial_thread_stop(false), command_notify_fd(-1), serial_stop_fd(-1),
+      render_target(target), matrix_target(target->asMatrix()), current_brightness(90), my_screen_id(screen_id), color_mode(color_mode), last_update_time(0),
+      next_load_ticket(0), timer_fd(-1), scene_changes(0), diagnostic_drawn(false), display_dirty(true), canvas_overwritten(false), static_layers_dirty(true), live_begin(0), live_end(0), stream_scratch(nullptr), fullscreen_next_frame(0), fullscreen_brightness(0) {
+    LIV_PROFILE_THREAD("render");
     
-    return best_index;
-}
-
-uint8_t ColorPalette::rgbTo8bitFast(uint8_t r, uint8_t g, uint8_t b) {
-    if (!lookup_initialized) initializeLookupTable();
-    return rgb_lookup[r][g][b];
-}
-
-Color8 ColorPalette::getColor(uint8_t index) {
-    if (!initialized) initialize();
-    if (index >= PALETTE_SIZE) index = 0;
-    return palette[index];
-}
-
-DisplayManager::DisplayManager(rgb_matrix::RGBMatrix* matrix, bool swap_dimensions, uint8_t screen_id) 
-    : matrix(matrix), canvas(nullptr), current_brightness(90), my_screen_id(screen_id), last_update_time(0), diagnostic_drawn(false), display_dirty(true) {
     // Initialize color palette
     ColorPalette::initialize();
     
-    // Set screen dimensions based on matrix size
+    // Set screen dimensions based on the render target size
     // V-mapper swaps dimensions in the library, so matrix reports swapped values already
     // We need to use them directly (width becomes height, height becomes width from our perspective)
-    SCREEN_WIDTH = matrix->width();
-    SCREEN_HEIGHT = matrix->height();
+    SCREEN_WIDTH = render_target->width();
+    SCREEN_HEIGHT = render_target->height();
     
     if (swap_dimensions) {
         std::cout << "DisplayManager initialized for " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT 
-                  << " screen (V-mapper active - library reports: width=" << matrix->width() 
-                  << ", height=" << matrix->height() << ")" << std::endl;
+                  << " screen (V-mapper active - library reports: width=" << render_target->width() 
+                  << ", height=" << render_target->height() << ")" << std::endl;
     } else {
-        std::cout << "DisplayManager initialized for " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << " screen" << std::endl;
+        std::cout << "DisplayManager initialized for " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << " screen"
+                  << (matrix_target ? "" : " (headless)") << std::endl;
     }
     
+    std::cout << "Compositor row kernels: " << rowKernels().name
+              << ", color mode: " << colorModeName(color_mode) << std::endl;
+    compose_buffer.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    static_background.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    static_overlay.resize(SCREEN_WIDTH, SCREEN_HEIGHT, true);
+    damage.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    previous_damage.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    
     // Load BDF font
     if (!bdf_font.loadFromFile("fonts/5x7.bdf")) {
         std::cerr << "Failed to load BDF font, using fallback" << std::endl;
@@ -149,12 +60,24 @@ DisplayManager::DisplayManager(rgb_matrix::RGBMatrix* matrix, bool swap_dimensio
 }
 
 DisplayManager::~DisplayManager() {
+    stopSerialThread();
     serial_protocol.close();
+    
+    // Commands received but never applied
+    QueuedCommand queued;
+    while (command_queue.pop(&queued)) {
+        serial_protocol.freeCommand(queued.command);
+    }
+    if (command_notify_fd >= 0) {
+        close(command_notify_fd);
+    }
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
 }
 
-bool DisplayManager::init(const std::string& serial_port) {
-    canvas = matrix->CreateFrameCanvas();
-    if (!canvas) {
+bool DisplayManager::init(const std::string& serial_port, const std::string& capture_file) {
+    if (matrix_target && !matrix_target->canvas()) {
         std::cerr << "Failed to create canvas" << std::endl;
         return false;
     }
@@ -165,11 +88,35 @@ bool DisplayManager::init(const std::string& serial_port) {
         std::cerr << "Make sure ESP32 is connected and you have permission to access the port" << std::endl;
         // Continue without protocol - not critical for basic functionality
     } else {
+        // Record the session for liv-replay
+        if (!capture_file.empty()) {
+            serial_protocol.startCapture(capture_file);
+        }
+        
         // Send test data to verify communication
         std::cout << "Sending test data to verify serial communication..." << std::endl;
         serial_protocol.sendTestData();
     }
     
+    // Serial reading and packet parsing run on their own thread, so a slow
+    // frame never delays the UART and a packet burst never delays a frame
+    command_notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    serial_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (command_notify_fd < 0 || serial_stop_fd < 0) {
+        perror("eventfd");
+        return false;
+    }
+    if (serial_protocol.getFd() >= 0) {
+        serial_thread = std::thread(&DisplayManager::serialThreadMain, this);
+    }
+    
+    // Wakes waitForEvents() at the next frame / blink / scroll deadline
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+    
     // Add diagnostic display elements
     addDiagnosticElements();
     
@@ -178,47 +125,190 @@ bool DisplayManager::init(const std::string& serial_port) {
 }
 
 void DisplayManager::processSerialCommands() {
-    serial_protocol.processData();
+    QueuedCommand queued;
+    while (command_queue.pop(&queued)) {
+        queued.trace.dequeued_us = getCurrentTimeUs();
+        applyCommand(queued.command, queued.trace);
+    }
+}
+
+size_t DisplayManager::replaySerialBytes(const uint8_t* data, size_t length, uint64_t time_us) {
+    serial_protocol.processBytes(data, length, time_us);
     
+    size_t applied = 0;
     while (serial_protocol.hasPendingCommand()) {
-        void* command = serial_protocol.getNextCommand();
+        CommandTrace trace;
+        void* command = serial_protocol.getNextCommand(&trace);
         if (!command) continue;
+        trace.dequeued_us = getCurrentTimeUs();
+        applyCommand(command, trace);
+        applied++;
+    }
+    return applied;
+}
+
+void DisplayManager::applyCommand(void* command, CommandTrace& trace) {
+    CommandType cmd_type = serial_protocol.getCommandType(command);
+    const uint64_t changes_before = scene_changes;
+    LIV_PROFILE_SCOPE(LatencyStats::commandName(cmd_type));
+    
+    // A GIF is applied when its decoded frames are installed, possibly
+    // frames later - its trace waits for installGifElement()
+    if (cmd_type == CMD_LOAD_GIF) {
+        uint8_t element_id = ((GifCommand*)command)->element_id;
+        auto superseded = gif_traces.find(element_id);
+        if (superseded != gif_traces.end()) {
+            latency_stats.record(superseded->second);
+        }
+        gif_traces[element_id] = trace;
+    }
+    
+    switch (cmd_type) {
+        case CMD_LOAD_GIF:
+            processGifCommand((GifCommand*)command);
+            break;
+        case CMD_DISPLAY_TEXT:
+            processTextCommand((TextCommand*)command);
+            break;
+        case CMD_CLEAR_SCREEN:
+            processClearCommand((ClearCommand*)command);
+            break;
+        case CMD_CLEAR_TEXT:
+            processClearTextCommand((ClearCommand*)command); // Same structure as ClearCommand
+            break;
+        case CMD_DELETE_ELEMENT:
+            processDeleteElementCommand((DeleteElementCommand*)command);
+            break;
+        case CMD_SET_BRIGHTNESS:
+            processBrightnessCommand((BrightnessCommand*)command);
+            break;
+        case CMD_GET_STATUS:
+            processStatusCommand((StatusCommand*)command);
+            break;
+        default:
+            break;
+    }
+    
+    if (cmd_type != CMD_LOAD_GIF) {
+        trace.applied_us = getCurrentTimeUs();
+        if (scene_changes != changes_before) {
+            awaiting_photon.push_back(trace);
+        } else {
+            latency_stats.record(trace);  // Nothing to show (status, ignored, no-op)
+        }
+    }
+    // Rejected GIFs, and loads this command cancelled
+    if (!gif_traces.empty()) {
+        finishGifTraces();
+    }
+    
+    serial_protocol.freeCommand(command);
+}
+
+void DisplayManager::serialThreadMain() {
+    // Leave SIGINT/SIGTERM/SIGHUP/SIGUSR1/SIGUSR2 to the main thread so they interrupt its poll()
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    LIV_PROFILE_THREAD("serial");
+    
+    QueuedCommand held_command;  // Parsed but the queue was full
+    held_command.command = nullptr;
+    uint64_t next_reopen_us = 0;
+    
+    while (!serial_thread_stop.load()) {
+        struct pollfd fds[2];
+        fds[0].fd = serial_protocol.getFd();  // -1 (ignored by poll) while the port is gone
+        fds[0].events = POLLIN;
+        fds[1].fd = serial_stop_fd;
+        fds[1].events = POLLIN;
+        
+        // With a command waiting for queue space, retry soon even without input;
+        // without a port, wake for the next reopen attempt
+        int timeout_ms = (held_command.command || serial_protocol.hasPendingCommand()) ? 1 : -1;
+        if (fds[0].fd < 0 && timeout_ms < 0) {
+            timeout_ms = SERIAL_REOPEN_INTERVAL_US / 1000;
+        }
+        if (poll(fds, 2, timeout_ms) < 0 && errno != EINTR) {
+            perror("serial poll");
+            break;
+        }
+        if (serial_thread_stop.load()) break;
         
-        CommandType cmd_type = serial_protocol.getCommandType(command);
+        // A hung-up tty (USB unplugged) reports POLLIN along with POLLHUP /
+        // POLLERR and reads return 0 or EIO for ever, so the hang-up is
+        // checked first: read what is left, close the port and reopen it
+        // every SERIAL_REOPEN_INTERVAL_US until the device is back
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            std::cerr << "Serial port hung up, closing it until the device is back" << std::endl;
+            if (fds[0].revents & POLLIN) {
+                serial_protocol.processData();
+            }
+            serial_protocol.close();
+            next_reopen_us = getCurrentTimeUs() + SERIAL_REOPEN_INTERVAL_US;
+        } else if (fds[0].revents & POLLIN) {
+            LIV_PROFILE_SCOPE("serial.read");
+            serial_protocol.processData();
+        } else if (fds[0].fd < 0 && getCurrentTimeUs() >= next_reopen_us) {
+            if (serial_protocol.reopen()) {
+                std::cout << "Serial port reopened" << std::endl;
+            }
+            next_reopen_us = getCurrentTimeUs() + SERIAL_REOPEN_INTERVAL_US;
+        }
         
-        switch (cmd_type) {
-            case CMD_LOAD_GIF:
-                processGifCommand((GifCommand*)command);
-                break;
-            case CMD_DISPLAY_TEXT:
-                processTextCommand((TextCommand*)command);
-                break;
-            case CMD_CLEAR_SCREEN:
-                processClearCommand((ClearCommand*)command);
-                break;
-            case CMD_CLEAR_TEXT:
-                processClearTextCommand((ClearCommand*)command); // Same structure as ClearCommand
-                break;
-            case CMD_DELETE_ELEMENT:
-                processDeleteElementCommand((DeleteElementCommand*)command);
-                break;
-            case CMD_SET_BRIGHTNESS:
-                processBrightnessCommand((BrightnessCommand*)command);
-                break;
-            case CMD_GET_STATUS:
-                processStatusCommand((StatusCommand*)command);
-                break;
-            default:
-                break;
+        bool queued = false;
+        while (true) {
+            if (!held_command.command) {
+                if (!serial_protocol.hasPendingCommand()) break;
+                held_command.trace = CommandTrace();
+                held_command.command = serial_protocol.getNextCommand(&held_command.trace);
+                if (!held_command.command) continue;
+            }
+            if (!command_queue.push(held_command)) break; // Render thread is behind
+            held_command.command = nullptr;
+            queued = true;
         }
         
-        serial_protocol.freeCommand(command);
+        if (queued) {
+            uint64_t one = 1;
+            if (write(command_notify_fd, &one, sizeof(one)) < 0) {
+                perror("eventfd write");
+            }
+        }
+    }
+    
+    if (held_command.command) {
+        serial_protocol.freeCommand(held_command.command);
+    }
+}
+
+void DisplayManager::stopSerialThread() {
+    if (serial_thread.joinable()) {
+        serial_thread_stop.store(true);
+        uint64_t one = 1;
+        if (write(serial_stop_fd, &one, sizeof(one)) < 0) {
+            perror("eventfd write");
+        }
+        serial_thread.join();
+    }
+    if (serial_stop_fd >= 0) {
+        close(serial_stop_fd);
+        serial_stop_fd = -1;
     }
 }
 
 void DisplayManager::updateDisplay() {
+    LIV_PROFILE_SCOPE("frame");
     uint64_t current_time = getCurrentTimeUs();
     
+    // Swap in GIFs the loader has finished decoding
+    applyLoadedGifs();
+    
     // Only clear canvas if we have elements to draw
     bool has_active_elements = false;
     bool has_animated_content = false;
@@ -227,9 +317,7 @@ void DisplayManager::updateDisplay() {
         if (element.active) {
             has_active_elements = true;
             // Check if this is animated content (GIF, scrolling text, or blinking text)
-            if (element.type == DisplayElement::GIF || 
-                (element.type == DisplayElement::TEXT && static_cast<int>(element.text.length() * element.font_size) > SCREEN_WIDTH - element.x) ||
-                (element.type == DisplayElement::TEXT && element.blink_interval_ms > 0)) {
+            if (isAnimated(element)) {
                 has_animated_content = true;
             }
         }
@@ -240,56 +328,365 @@ void DisplayManager::updateDisplay() {
         return; // Skip rendering for static content that hasn't changed
     }
     
-    if (has_active_elements) {
-        // Clear canvas only when we have elements to draw
-        canvas->Clear();
-        diagnostic_drawn = false; // Reset flag when we have elements
-    } else {
+    // Fast path: a single full-screen GIF with nothing over it is played
+    // from its pre-rendered FrameCanvas stream (panels only)
+    DisplayElement* fullscreen = matrix_target ? findFullscreenGif() : nullptr;
+    if (fullscreen) {
+        bool stream_ready = (fullscreen_frames == fullscreen->gif_frames &&
+                             fullscreen_brightness == render_target->brightness());
+        if (!stream_ready) {
+            stream_ready = buildFullscreenStream(*fullscreen);
+        }
+        if (stream_ready) {
+            size_t shown_frame = fullscreen->current_frame;
+            updateGifElement(*fullscreen);
+            if (display_dirty || fullscreen->current_frame != shown_frame) {
+                showFullscreenFrame(fullscreen->current_frame);
+            }
+            display_dirty = false;
+            last_update_time = current_time;
+            return;
+        }
+    } else if (fullscreen_stream) {
+        // Another element was added (or the GIF removed) - back to the compositor
+        std::cout << "Full-screen stream released, using compositor" << std::endl;
+        releaseFullscreenStream();
+    }
+    
+    // The canvases hold something the compositor did not draw - repaint all
+    if (canvas_overwritten) {
+        markAllDirty();
+        canvas_overwritten = false;
+    }
+    
+    if (!has_active_elements) {
         // If no elements, draw diagnostic pattern only once
         if (!diagnostic_drawn) {
             addDiagnosticElements();
             diagnostic_drawn = true;
         }
+        recordUnshownCommands();
+        display_dirty = false; // Nothing more to draw until the next command
         return; // Don't process elements since there are none
     }
+    diagnostic_drawn = false; // Reset flag when we have elements
     
-    // Update and draw all active elements
-    // Draw in two passes: GIFs first, then TEXT on top
-    
-    // Pass 1: Draw GIF elements (background layer)
-    for (auto& element : elements) {
-        if (!element.active) continue;
-        
-        if (element.type == DisplayElement::GIF) {
-            updateGifElement(element);
-            drawGifElement(element);
-        }
-    }
-    
-    // Pass 2: Draw TEXT elements (foreground layer - always on top)
-    for (auto& element : elements) {
-        if (!element.active) continue;
-        
-        if (element.type == DisplayElement::TEXT) {
-            updateTextElement(element);
-            drawTextElement(element);
+    // Advance animations; each element that visibly changed marks its area
+    {
+        LIV_PROFILE_SCOPE("update");
+        for (auto& element : elements) {
+            if (!element.active) continue;
+            
+            if (element.type == DisplayElement::GIF) {
+                size_t shown_frame = element.current_frame;
+                updateGifElement(element);
+                if (element.current_frame != shown_frame) {
+                    markDirty(elementBounds(element));
+                }
+            } else if (element.type == DisplayElement::TEXT) {
+                updateTextElement(element);
+            }
         }
     }
     
     // Clear dirty flag after rendering
     display_dirty = false;
     
+    // Nothing visible changed (e.g. woken for a frame with the same image)
+    if (!damage.any()) {
+        recordUnshownCommands();
+        last_update_time = current_time;
+        return;
+    }
+    
+    composeDamage();
+    
+    // The canvas we draw into was last shown two frames ago: push what
+    // changed in this frame and in the previous one
+    DamageMap flush_area = damage;
+    flush_area.merge(previous_damage);
+    flushToCanvas(flush_area);
+    
     // Swap canvas only when we actually rendered something
-    canvas = matrix->SwapOnVSync(canvas, 1);
+    presentFrame();
     //matrix->SetBrightness(50);
     //led_matrix_set_brightness(matrix, 3);
     
+    previous_damage = damage;
+    damage.clear();
     last_update_time = current_time;
 }
 
+void DisplayManager::markDirty(const Rect& area) {
+    damage.mark(area);
+    display_dirty = true;
+    scene_changes++;
+}
+
+void DisplayManager::markAllDirty() {
+    damage.markAll();
+    display_dirty = true;
+    scene_changes++;
+}
+
+void DisplayManager::presentFrame() {
+    {
+        LIV_PROFILE_SCOPE("swap");
+        render_target->swap();
+    }
+    if (awaiting_photon.empty()) return;
+    
+    // On the panels swap() returns at the VSync that put the frame up
+    const uint64_t now = getCurrentTimeUs();
+    for (auto& trace : awaiting_photon) {
+        trace.shown_us = now;
+        latency_stats.record(trace);
+    }
+    awaiting_photon.clear();
+}
+
+void DisplayManager::recordUnshownCommands() {
+    for (const auto& trace : awaiting_photon) {
+        latency_stats.record(trace);
+    }
+    awaiting_photon.clear();
+}
+
+void DisplayManager::finishGifTraces() {
+    auto it = gif_traces.begin();
+    while (it != gif_traces.end()) {
+        if (pending_gif_loads.count(it->first) == 0) {
+            latency_stats.record(it->second);  // Never installed
+            it = gif_traces.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DisplayManager::markElementChanged(const Rect& area) {
+    markDirty(area);
+    static_layers_dirty = true;
+}
+
+bool DisplayManager::isAnimated(const DisplayElement& element) const {
+    if (element.type == DisplayElement::GIF) {
+        return element.gif_frames && element.gif_frames->frameCount() > 1;
+    }
+    return isScrollingText(element) || element.blink_interval_ms > 0;
+}
+
+void DisplayManager::rebuildStaticLayers() {
+    LIV_PROFILE_SCOPE("static_layers");
+    
+    // Z-order: GIFs first, then TEXT on top
+    draw_order.clear();
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].active && elements[i].type == DisplayElement::GIF) draw_order.push_back(i);
+    }
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].active && elements[i].type == DisplayElement::TEXT) draw_order.push_back(i);
+    }
+    
+    // Everything between the first and last animated element is drawn live;
+    // with nothing animated the whole scene is background
+    live_begin = draw_order.size();
+    live_end = draw_order.size();
+    for (size_t i = 0; i < draw_order.size(); i++) {
+        if (isAnimated(elements[draw_order[i]])) {
+            if (live_begin == draw_order.size()) live_begin = i;
+            live_end = i + 1;
+        }
+    }
+    
+    const Rect screen = compose_buffer.bounds();
+    static_background.clear();
+    static_overlay.clear();
+    for (size_t i = 0; i < draw_order.size(); i++) {
+        if (i >= live_begin && i < live_end) continue;
+        
+        const DisplayElement& element = elements[draw_order[i]];
+        Surface& layer = (i < live_begin) ? static_background : static_overlay;
+        LIV_PROFILE_ELEMENT_SCOPE("draw", element.element_id,
+                                  element.type == DisplayElement::GIF ? "GIF" : "TEXT");
+        if (element.type == DisplayElement::GIF) {
+            drawGifElement(element, layer, screen);
+        } else {
+            drawTextElement(element, layer, screen);
+        }
+    }
+    
+    static_layers_dirty = false;
+}
+
+void DisplayManager::composeDamage() {
+    LIV_PROFILE_SCOPE("compose");
+    
+    if (static_layers_dirty) {
+        rebuildStaticLayers();
+    }
+    
+    std::vector<Rect> live_bounds;
+    for (size_t i = live_begin; i < live_end; i++) {
+        live_bounds.push_back(elementBounds(elements[draw_order[i]]));
+    }
+    const bool has_overlay = live_end < draw_order.size();
+    
+    for (const Rect& area : damage.rects()) {
+        compose_buffer.copyFrom(static_background, area);
+        
+        for (size_t i = live_begin; i < live_end; i++) {
+            if (!live_bounds[i - live_begin].intersects(area)) continue;
+            
+            const DisplayElement& element = elements[draw_order[i]];
+            LIV_PROFILE_ELEMENT_SCOPE("draw", element.element_id,
+                                      element.type == DisplayElement::GIF ? "GIF" : "TEXT");
+            if (element.type == DisplayElement::GIF) {
+                drawGifElement(element, compose_buffer, area);
+            } else {
+                drawTextElement(element, compose_buffer, area);
+            }
+        }
+        
+        if (has_overlay) {
+            compose_buffer.blendFrom(static_overlay, area);
+        }
+    }
+}
+
+void DisplayManager::flushToCanvas(const DamageMap& area) {
+    LIV_PROFILE_SCOPE("flush");
+    for (const Rect& rect : area.rects()) {
+        for (int y = rect.y; y < rect.bottom(); y++) {
+            render_target->blitRow(rect.x, y, compose_buffer.row(y) + rect.x * 3, rect.width);
+        }
+    }
+}
+
+Rect DisplayManager::elementBounds(const DisplayElement& element) {
+    const Rect screen(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    
+    if (element.type == DisplayElement::GIF) {
+        if (!element.gif_frames) return Rect();
+        return Rect(element.x, element.y,
+                    std::min<int>(element.width, element.gif_frames->width()),
+                    std::min<int>(element.height, element.gif_frames->height())).intersect(screen);
+    }
+    
+    // Text: union of the glyph boxes of the whole string. Scrolling only
+    // drops characters from the front, so this also covers every scroll step.
+    Rect bounds;
+    BdfFont* font = textFont(element);
+    if (font) {
+        // Same placement as drawTextElement (native size, baseline aligned)
+        int baseline_y = element.y + font->getFontAscent();
+        int current_x = element.x;
+        for (size_t pos = 0; pos < element.text.size();) {
+            const BdfChar* bdf_char = font->getChar(utf8Next(element.text, &pos));
+            if (!bdf_char) continue;
+            bounds = bounds.unite(Rect(current_x + bdf_char->x_offset,
+                                       baseline_y - bdf_char->y_offset - bdf_char->height,
+                                       bdf_char->width, bdf_char->height));
+            current_x += bdf_char->dwidth;
+        }
+    } else {
+        // Same placement as drawString / drawChar (scaled default font)
+        const int scale = element.font_size;
+        int current_x = element.x;
+        for (size_t pos = 0; pos < element.text.size();) {
+            const BdfChar* bdf_char = bdf_font.getChar(utf8Next(element.text, &pos));
+            if (bdf_char) {
+                bounds = bounds.unite(Rect(current_x + bdf_char->x_offset * scale,
+                                           element.y + bdf_char->y_offset * scale,
+                                           bdf_char->width * scale, bdf_char->height * scale));
+                current_x += bdf_char->dwidth * scale;
+            } else {
+                bounds = bounds.unite(Rect(current_x, element.y, scale * 5, scale * 7));
+                current_x += scale * 6;
+            }
+        }
+    }
+    return bounds.intersect(screen);
+}
+
+uint64_t DisplayManager::nextDeadlineUs() {
+    uint64_t now = getCurrentTimeUs();
+    if (display_dirty) return now;
+    
+    uint64_t deadline = UINT64_MAX;
+    for (const auto& element : elements) {
+        if (!element.active) continue;
+        
+        if (element.type == DisplayElement::GIF) {
+            if (!element.gif_frames) continue;
+            uint64_t wait = element.gif_frames->timeToNextFrame(now - element.anim_start_time);
+            if (wait != UINT64_MAX) {
+                deadline = std::min(deadline, now + wait);
+            }
+        } else if (element.type == DisplayElement::TEXT) {
+            if (element.blink_interval_ms > 0) {
+                deadline = std::min<uint64_t>(deadline, element.last_blink_time + element.blink_interval_ms * 1000ULL);
+            }
+            if (isScrollingText(element)) {
+                deadline = std::min<uint64_t>(deadline, element.last_scroll_time + element.scroll_delay_us);
+            }
+        }
+    }
+    return deadline;
+}
+
+void DisplayManager::waitForEvents() {
+    LIV_PROFILE_SCOPE("idle");
+    uint64_t deadline = nextDeadlineUs();
+    
+    // Arm (or disarm, for a static screen) the timer at the absolute deadline
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (deadline != UINT64_MAX) {
+        // A zero it_value disarms the timer, so a due deadline fires in 1 ns
+        spec.it_value.tv_sec = deadline / 1000000ULL;
+        spec.it_value.tv_nsec = (deadline % 1000000ULL) * 1000ULL;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    
+    struct pollfd fds[3];
+    fds[0].fd = command_notify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = timer_fd;
+    fds[1].events = POLLIN;
+    fds[2].fd = gif_loader.notifyFd();
+    fds[2].events = POLLIN;
+    
+    int ready = poll(fds, 3, -1);
+    if (ready <= 0) return; // EINTR - let the caller check for shutdown
+    
+    if (fds[0].revents & POLLIN) {
+        uint64_t count;
+        if (read(command_notify_fd, &count, sizeof(count)) < 0) {
+            // EAGAIN - already drained
+        }
+    }
+    if (fds[1].revents & POLLIN) {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+            // EAGAIN - timer was re-armed meanwhile
+        }
+    }
+    if (fds[2].revents & POLLIN) {
+        gif_loader.drainNotifications();
+    }
+}
+
 void DisplayManager::clearScreen() {
-    canvas->Clear();
+    {
+        LIV_PROFILE_SCOPE("clear");
+        render_target->clear();
+    }
     elements.clear();
+    pending_gif_loads.clear(); // Loads still in flight are discarded when they finish
     
     // Clear command cache since all elements are removed
     for (int i = 0; i < 256; i++) {
@@ -298,7 +695,8 @@ void DisplayManager::clearScreen() {
     }
     
     diagnostic_drawn = false; // Reset flag when clearing screen
-    display_dirty = true; // Mark display as needing update
+    markAllDirty(); // Mark display as needing update
+    static_layers_dirty = true;
     std::cout << "Screen cleared, cache reset" << std::endl;
 }
 
@@ -311,6 +709,7 @@ void DisplayManager::clearText() {
         if (it->type == DisplayElement::TEXT) {
             // Clear cache for this text element
             command_cache.text_checksums[it->element_id] = 0;
+            markElementChanged(elementBounds(*it));
             it = elements.erase(it);
         } else {
             ++it;
@@ -326,83 +725,163 @@ void DisplayManager::clearText() {
 
 void DisplayManager::setBrightness(uint8_t brightness) {
     current_brightness = std::min(brightness, (uint8_t)100);
-    matrix->SetBrightness(current_brightness);
+    render_target->setBrightness(current_brightness);
+    // Brightness is applied as pixels are set - push every pixel again
+    markAllDirty();
 }
 
 bool DisplayManager::addGifElement(const std::string& filename, uint16_t x, uint16_t y, 
-                                  uint16_t width, uint16_t height, uint8_t element_id) {
+                                  uint16_t width, uint16_t height, uint8_t element_id,
+                                  bool send_response) {
     std::cout << "addGifElement called: ID=" << (int)element_id << " " << filename << " at (" << x << "," << y << ") size " << width << "x" << height << std::endl;
     
-    // Check if element with same ID already exists - if so, remove it first
-    auto it = elements.begin();
-    while (it != elements.end()) {
-        if (it->element_id == element_id) {
-            std::cout << "Removing duplicate element with ID=" << (int)element_id << std::endl;
-            // Note: we don't clear cache here because the new element will update it
-            it = elements.erase(it);
-        } else {
-            ++it;
-        }
-    }
-    
     // Check bounds
     if (!isWithinBounds(x, y, width, height)) {
         std::cout << "Bounds check failed" << std::endl;
         return false;
     }
     
-    // Load GIF
-    std::vector<Magick::Image> frames;
-    std::string err_msg;
-    
-    if (!LoadImageAndScale(filename.c_str(), width, height, false, false, &frames, &err_msg)) {
-        std::cerr << "Failed to load GIF: " << filename << " - " << err_msg << std::endl;
+    // Fail fast on missing files instead of after a round trip to the loader
+    if (access(filename.c_str(), R_OK) != 0) {
+        std::cerr << "Failed to load GIF: " << filename << " - file not found" << std::endl;
         return false;
     }
     
+    GifLoadRequest request;
+    request.ticket = ++next_load_ticket;
+    request.filename = filename;
+    request.x = x;
+    request.y = y;
+    request.width = width;
+    request.height = height;
+    request.color_mode = color_mode;
+    request.element_id = element_id;
+    request.screen_id = my_screen_id;
+    request.send_response = send_response;
+    
+    // Already decoded at this size - show it right away
+    std::shared_ptr<const FrameStore> cached = AssetCache::instance().find(filename, width, height, color_mode);
+    if (cached) {
+        std::cout << "GIF cache hit: " << filename << " " << width << "x" << height << std::endl;
+        pending_gif_loads.erase(element_id); // Supersedes a load still in flight
+        installGifElement(request, cached);
+        return true;
+    }
+    
+    // Decode on the loader thread; any element with the same ID stays on
+    // screen until applyLoadedGifs() swaps the new one in
+    pending_gif_loads[element_id] = request.ticket;
+    gif_loader.submit(request);
+    std::cout << "GIF load queued: ID=" << (int)element_id << " ticket=" << request.ticket << std::endl;
+    return true;
+}
+
+void DisplayManager::applyLoadedGifs() {
+    GifLoadResult result;
+    while (gif_loader.poll(&result)) {
+        const GifLoadRequest& request = result.request;
+        
+        // Ignore loads superseded by a newer LOAD_GIF, a delete or a clear
+        auto pending = pending_gif_loads.find(request.element_id);
+        if (pending == pending_gif_loads.end() || pending->second != request.ticket) {
+            std::cout << "Discarding stale GIF load: ID=" << (int)request.element_id
+                      << " " << request.filename << std::endl;
+            continue;
+        }
+        pending_gif_loads.erase(pending);
+        
+        if (!result.frames) {
+            std::cerr << "Failed to load GIF: " << request.filename << " - " << result.error << std::endl;
+            command_cache.gif_checksums[request.element_id] = 0;
+            if (request.send_response) {
+                serial_protocol.sendResponse(request.screen_id, RESP_FILE_NOT_FOUND);
+            }
+            continue;
+        }
+        
+        installGifElement(request, result.frames);
+    }
+    
+    // Failed loads
+    if (!gif_traces.empty()) {
+        finishGifTraces();
+    }
+}
+
+void DisplayManager::installGifElement(const GifLoadRequest& request,
+                                       const std::shared_ptr<const FrameStore>& frames) {
+    LIV_PROFILE_ELEMENT_SCOPE("gif.install", request.element_id, "GIF");
+    
+    // Replace the element with the same ID, if any
+    auto it = elements.begin();
+    while (it != elements.end()) {
+        if (it->element_id == request.element_id) {
+            std::cout << "Removing duplicate element with ID=" << (int)request.element_id << std::endl;
+            markElementChanged(elementBounds(*it));
+            it = elements.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
     // Create new element
     DisplayElement element;
     element.type = DisplayElement::GIF;
-    element.element_id = element_id;
-    element.x = x;
-    element.y = y;
-    element.width = width;
-    element.height = height;
-    element.filename = filename;
+    element.element_id = request.element_id;
+    element.x = request.x;
+    element.y = request.y;
+    element.width = request.width;
+    element.height = request.height;
+    element.filename = request.filename;
     element.gif_frames = frames;
     element.current_frame = 0;
-    element.last_frame_time = getCurrentTimeUs();
+    element.anim_start_time = getCurrentTimeUs();
     element.active = true;
     
-    if (!frames.empty()) {
-        element.frame_delay_us = frames[0].animationDelay() * 10000;
-        if (element.frame_delay_us <= 0) element.frame_delay_us = 100000;
-    }
+    std::cout << "GIF ready: " << element.gif_frames->frameCount() << " frames "
+              << element.gif_frames->width() << "x" << element.gif_frames->height()
+              << ", " << element.gif_frames->durationUs() / 1000 << " ms loop"
+              << ", " << element.gif_frames->memoryBytes() / 1024 << " KB" << std::endl;
     
     elements.push_back(element);
-    display_dirty = true; // Mark display as needing update
+    markElementChanged(elementBounds(element)); // Mark display as needing update
+    
+    // The LOAD_GIF command is applied now; it is shown by the next swap
+    auto trace = gif_traces.find(request.element_id);
+    if (trace != gif_traces.end()) {
+        trace->second.applied_us = getCurrentTimeUs();
+        awaiting_photon.push_back(trace->second);
+        gif_traces.erase(trace);
+    }
     std::cout << "GIF element added successfully. Total elements: " << elements.size() << std::endl;
-    return true;
+    
+    if (request.send_response) {
+        serial_protocol.sendResponse(request.screen_id, RESP_OK);
+    }
 }
 
 bool DisplayManager::addTextElement(const std::string& text, uint16_t x, uint16_t y,
-                                   uint8_t font_size, uint8_t color_index, const std::string& font_name, 
+                                   uint8_t font_size, Color8 color, const std::string& font_name, 
                                    uint8_t element_id, uint16_t blink_interval_ms) {
+    // A newer command for this ID wins over a GIF still being decoded
+    pending_gif_loads.erase(element_id);
+    
     // Check if element with same ID already exists
     for (auto& element : elements) {
         if (element.element_id == element_id) {
             // Update existing element text without recreating it (prevents flicker)
+            markElementChanged(elementBounds(element)); // Old text
             element.text = text;
             element.x = x;
             element.y = y;
-            element.color_index = color_index;
+            element.color = color;
             element.font_name = font_name;
-            element.width = font_size * text.length();
+            element.width = font_size * utf8Length(text);
             element.height = font_size * 8;
             element.blink_interval_ms = blink_interval_ms;
             element.blink_visible = true;
             element.last_blink_time = getCurrentTimeUs();
-            display_dirty = true;
+            markElementChanged(elementBounds(element)); // New text
             std::cout << "Element ID=" << (int)element_id << " updated: '" << text << "'"
                       << " blink=" << blink_interval_ms << "ms" << std::endl;
             return true;
@@ -411,7 +890,7 @@ bool DisplayManager::addTextElement(const std::string& text, uint16_t x, uint16_
     
     // No existing element found, create new one
     // Check bounds
-    if (!isWithinBounds(x, y, font_size * text.length(), font_size * 8)) {
+    if (!isWithinBounds(x, y, font_size * utf8Length(text), font_size * 8)) {
         std::cout << "Text bounds check failed" << std::endl;
         return false;
     }
@@ -422,12 +901,12 @@ bool DisplayManager::addTextElement(const std::string& text, uint16_t x, uint16_
     element.element_id = element_id;
     element.x = x;
     element.y = y;
-    element.width = font_size * text.length();
+    element.width = font_size * utf8Length(text);
     element.height = font_size * 8;
     element.text = text;
     element.font_name = font_name;
     element.font_size = font_size;
-    element.color_index = color_index;
+    element.color = color;
     element.scroll_offset = 0;
     element.last_scroll_time = getCurrentTimeUs();
     element.blink_interval_ms = blink_interval_ms;
@@ -438,7 +917,7 @@ bool DisplayManager::addTextElement(const std::string& text, uint16_t x, uint16_
     elements.push_back(element);
     std::cout << "Element ID=" << (int)element_id << " added. Total elements: " << elements.size()
               << " blink=" << blink_interval_ms << "ms" << std::endl;
-    display_dirty = true; // Mark display as needing update
+    markElementChanged(elementBounds(element)); // Mark display as needing update
     return true;
 }
 
@@ -453,6 +932,7 @@ void DisplayManager::removeElement(uint16_t x, uint16_t y) {
             }
             
             it->active = false;
+            markElementChanged(elementBounds(*it));
             elements.erase(it);
             std::cout << "Element removed at (" << x << "," << y << "), cache cleared" << std::endl;
             break;
@@ -463,43 +943,61 @@ void DisplayManager::removeElement(uint16_t x, uint16_t y) {
 std::string DisplayManager::getStatus() {
     std::string status = "Screen: " + std::to_string(SCREEN_WIDTH) + "x" + std::to_string(SCREEN_HEIGHT) + 
                         ", Elements: " + std::to_string(elements.size()) + 
-                        ", Brightness: " + std::to_string(current_brightness);
+                        ", Brightness: " + std::to_string(current_brightness) +
+                        ", Assets: " + std::to_string(AssetCache::instance().entryCount()) +
+                        " (" + std::to_string(AssetCache::instance().memoryBytes() / 1024) + " KB)";
     return status;
 }
 
-void DisplayManager::drawGifElement(const DisplayElement& element) {
-    if (element.gif_frames.empty() || element.current_frame >= element.gif_frames.size()) {
+void DisplayManager::dumpLatencyStats() {
+    latency_stats.dump(std::cout);
+}
+
+void DisplayManager::drawGifElement(const DisplayElement& element, Surface& target, const Rect& clip) {
+    if (!element.gif_frames || element.current_frame >= element.gif_frames->frameCount()) {
         return;
     }
     
-    const Magick::Image& img = element.gif_frames[element.current_frame];
-    
-    // Clip to screen bounds
-    uint16_t draw_x = element.x;
-    uint16_t draw_y = element.y;
-    uint16_t draw_width = element.width;
-    uint16_t draw_height = element.height;
-    clipToBounds(draw_x, draw_y, draw_width, draw_height);
-    
-    // Draw image
-    for (size_t y = 0; y < img.rows() && y < draw_height; ++y) {
-        for (size_t x = 0; x < img.columns() && x < draw_width; ++x) {
-            const Magick::Color& c = img.pixelColor(x, y);
-            if (c.alphaQuantum() < 255) {
-                // Convert 24-bit RGB to 8-bit color index using fast lookup
-                uint8_t r = ScaleQuantumToChar(c.redQuantum());
-                uint8_t g = ScaleQuantumToChar(c.greenQuantum());
-                uint8_t b = ScaleQuantumToChar(c.blueQuantum());
-                uint8_t color_index = ColorPalette::rgbTo8bitFast(r, g, b);
-                Color8 color = ColorPalette::getColor(color_index);
-                
-                canvas->SetPixel(draw_x + x, draw_y + y, color.r, color.g, color.b);
-            }
-        }
+    const FrameStore& store = *element.gif_frames;
+    const PackedFrame& frame = store.frame(element.current_frame);
+    
+    // Clip to the element, the screen and the area being redrawn
+    Rect area = elementBounds(element).intersect(clip);
+    
+    // Draw image - colours are already palette-mapped, only the mask is tested
+    for (int y = area.y; y < area.bottom(); ++y) {
+        const int src_y = y - element.y;
+        blitMaskedRow(target.row(y) + element.x * 3,
+                      frame.rgb + (size_t)src_y * store.width() * 3,
+                      frame.mask + (size_t)src_y * store.maskStride(),
+                      area.x - element.x, area.width);
+    }
+}
+
+BdfFont* DisplayManager::textFont(const DisplayElement& element) {
+    // Load font if specified and different from current
+    if (element.font_name.empty() || element.font_name == "fonts/5x7.bdf") {
+        return nullptr;
+    }
+    
+    // Check if font is already in cache
+    auto it = font_cache.find(element.font_name);
+    if (it != font_cache.end()) {
+        // Font found in cache, use it
+        return &(it->second);
     }
+    
+    // Font not in cache, load it and cache it
+    BdfFont new_font;
+    if (new_font.loadFromFile(element.font_name)) {
+        font_cache[element.font_name] = std::move(new_font);
+        std::cout << "Font " << element.font_name << " loaded and cached" << std::endl;
+        return &font_cache[element.font_name];
+    }
+    return nullptr;
 }
 
-void DisplayManager::drawTextElement(const DisplayElement& element) {
+void DisplayManager::drawTextElement(const DisplayElement& element, Surface& target, const Rect& clip) {
     if (element.text.empty()) return;
     
     // Check blink visibility - if blinking is enabled and text is hidden, don't draw
@@ -507,113 +1005,154 @@ void DisplayManager::drawTextElement(const DisplayElement& element) {
         return; // Text is currently hidden due to blinking
     }
     
-    // Load font if specified and different from current
-    if (!element.font_name.empty() && element.font_name != "fonts/5x7.bdf") {
-        // Check if font is already in cache
-        BdfFont* font_to_use = nullptr;
+    // Handle scrolling: skip the characters scrolled out (UTF-8 aware)
+    size_t start = 0;
+    if (element.scroll_offset > 0) {
+        start = utf8Skip(element.text, element.scroll_offset / element.font_size);
+    }
+    
+    BdfFont* font_to_use = textFont(element);
+    if (font_to_use) {
+        // Use cached font for rendering
+        uint16_t x = element.x;
+        uint16_t y = element.y;
         
-        auto it = font_cache.find(element.font_name);
-        if (it != font_cache.end()) {
-            // Font found in cache, use it
-            font_to_use = &(it->second);
-        } else {
-            // Font not in cache, load it and cache it
-            BdfFont new_font;
-            if (new_font.loadFromFile(element.font_name)) {
-                font_cache[element.font_name] = std::move(new_font);
-                font_to_use = &font_cache[element.font_name];
-                std::cout << "Font " << element.font_name << " loaded and cached" << std::endl;
-            }
-        }
+        // Draw with custom font - native size (no scaling)
+        // Calculate baseline position for proper vertical alignment
+        int baseline_y = y + font_to_use->getFontAscent();
         
-        if (font_to_use) {
-            // Use cached font for rendering
-            uint16_t x = element.x;
-            uint16_t y = element.y;
-            
-            // Handle scrolling
-            std::string display_text = element.text;
-            if (element.scroll_offset > 0) {
-                size_t offset = element.scroll_offset / element.font_size;
-                if (offset < display_text.length()) {
-                    display_text = display_text.substr(offset);
-                } else {
-                    display_text = "";
-                }
-            }
-            
-            // Draw with custom font - native size (no scaling)
-            // Calculate baseline position for proper vertical alignment
-            int baseline_y = y + font_to_use->getFontAscent();
+        uint16_t current_x = x;
+        for (size_t pos = start; pos < element.text.size();) {
+            if (current_x >= SCREEN_WIDTH) break;
             
-            uint16_t current_x = x;
-            for (char c : display_text) {
-                if (current_x >= SCREEN_WIDTH) break;
-                
-                const BdfChar* bdf_char = font_to_use->getChar(static_cast<uint32_t>(c));
-                if (bdf_char) {
-                    // Draw character using cached font at native size
-                    // In BDF: y_offset is distance from baseline to character's bottom edge
-                    // Characters are drawn from top (row=0) to bottom (row=height-1)
-                    int bytes_per_row = (bdf_char->width + 7) / 8;
-                    for (int row = 0; row < bdf_char->height; row++) {
-                        for (int col = 0; col < bdf_char->width; col++) {
-                            int byte_index = row * bytes_per_row + (col / 8);
-                            int bit_index = 7 - (col % 8);
+            const BdfChar* bdf_char = font_to_use->getChar(utf8Next(element.text, &pos));
+            if (bdf_char) {
+                // Draw character using cached font at native size
+                // In BDF: y_offset is distance from baseline to character's bottom edge
+                // Characters are drawn from top (row=0) to bottom (row=height-1)
+                const uint8_t* bitmap = font_to_use->glyphBitmap(bdf_char);
+                int bytes_per_row = (bdf_char->width + 7) / 8;
+                for (int row = 0; row < bdf_char->height; row++) {
+                    for (int col = 0; col < bdf_char->width; col++) {
+                        int byte_index = row * bytes_per_row + (col / 8);
+                        int bit_index = 7 - (col % 8);
+                        
+                        uint8_t byte_val = bitmap[byte_index];
+                        if (byte_val & (1 << bit_index)) {
+                            const Color8& color = element.color;
+                            // Apply x_offset horizontally
+                            int px = current_x + col + bdf_char->x_offset;
+                            // Apply baseline-relative positioning:
+                            // In BDF: y_offset is offset from baseline to bottom-left corner
+                            // bottom = baseline_y - y_offset (screen coords, Y grows down)
+                            // top = bottom - height
+                            // For row r (0=top): py = baseline_y - y_offset - height + row
+                            int py = baseline_y - bdf_char->y_offset - bdf_char->height + row;
                             
-                            if (byte_index < (int)bdf_char->bitmap.size()) {
-                                uint8_t byte_val = bdf_char->bitmap[byte_index];
-                                if (byte_val & (1 << bit_index)) {
-                                    Color8 color = ColorPalette::getColor(element.color_index);
-                                    // Apply x_offset horizontally
-                                    int px = current_x + col + bdf_char->x_offset;
-                                    // Apply baseline-relative positioning:
-                                    // In BDF: y_offset is offset from baseline to bottom-left corner
-                                    // bottom = baseline_y - y_offset (screen coords, Y grows down)
-                                    // top = bottom - height
-                                    // For row r (0=top): py = baseline_y - y_offset - height + row
-                                    int py = baseline_y - bdf_char->y_offset - bdf_char->height + row;
-                                    
-                                    if (px >= 0 && px < SCREEN_WIDTH && py >= 0 && py < SCREEN_HEIGHT) {
-                                        canvas->SetPixel(px, py, color.r, color.g, color.b);
-                                    }
-                                }
+                            if (clip.contains(px, py)) {
+                                target.setPixel(px, py, color.r, color.g, color.b);
                             }
                         }
                     }
-                    // Move to next character position using DWIDTH (advancement width)
-                    current_x += bdf_char->dwidth;
                 }
+                // Move to next character position using DWIDTH (advancement width)
+                current_x += bdf_char->dwidth;
             }
-            return;
         }
+        return;
     }
     
     // Fallback to default font
-    uint16_t x = element.x;
-    uint16_t y = element.y;
+    drawString(element.text, element.x, element.y, element.font_size, element.color, target, clip, start);
+}
+
+void DisplayManager::updateGifElement(DisplayElement& element) {
+    // Pick the frame from elapsed time rather than stepping once per call,
+    // so playback speed stays right when a render pass runs long (frames are
+    // skipped instead of the whole animation drifting)
+    uint64_t elapsed = getCurrentTimeUs() - element.anim_start_time;
+    element.current_frame = element.gif_frames->frameAt(elapsed);
+}
+
+DisplayElement* DisplayManager::findFullscreenGif() {
+    DisplayElement* found = nullptr;
+    for (auto& element : elements) {
+        if (!element.active) continue;
+        if (found) return nullptr; // Something else is drawn too
+        found = &element;
+    }
     
-    // Handle scrolling
-    std::string display_text = element.text;
-    if (element.scroll_offset > 0) {
-        size_t offset = element.scroll_offset / element.font_size;
-        if (offset < display_text.length()) {
-            display_text = display_text.substr(offset);
-        } else {
-            display_text = "";
+    if (!found || found->type != DisplayElement::GIF || !found->gif_frames) return nullptr;
+    if (found->x != 0 || found->y != 0 ||
+        found->width != SCREEN_WIDTH || found->height != SCREEN_HEIGHT) return nullptr;
+    if (fullscreen_rejected.lock() == found->gif_frames) return nullptr;
+    return found;
+}
+
+bool DisplayManager::buildFullscreenStream(const DisplayElement& element) {
+    releaseFullscreenStream();
+    
+    if (!stream_scratch) {
+        // Frame canvases are owned by the matrix, create the scratch one once
+        stream_scratch = matrix_target->matrix()->CreateFrameCanvas();
+        if (!stream_scratch) return false;
+    }
+    stream_scratch->SetBrightness(render_target->brightness());
+    
+    const FrameStore& store = *element.gif_frames;
+    std::unique_ptr<rgb_matrix::MemStreamIO> stream(new rgb_matrix::MemStreamIO());
+    rgb_matrix::StreamWriter writer(stream.get());
+    
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < store.frameCount(); i++) {
+        total_bytes += StoreInStream(store, i, 0, 0, stream_scratch, &writer);
+        if (total_bytes > FULLSCREEN_STREAM_MAX_BYTES) {
+            std::cout << "Full-screen stream for " << element.filename << " exceeds "
+                      << FULLSCREEN_STREAM_MAX_BYTES / (1024 * 1024) << " MB, using compositor" << std::endl;
+            fullscreen_rejected = element.gif_frames;
+            return false;
         }
     }
     
-    drawString(display_text, x, y, element.font_size, element.color_index);
+    fullscreen_stream = std::move(stream);
+    fullscreen_reader.reset(new rgb_matrix::StreamReader(fullscreen_stream.get()));
+    fullscreen_frames = element.gif_frames;
+    fullscreen_next_frame = 0;
+    fullscreen_brightness = render_target->brightness();
+    display_dirty = true; // Show the current frame from the stream right away
+    
+    std::cout << "Full-screen stream built for " << element.filename << ": "
+              << store.frameCount() << " frames, " << total_bytes / 1024 << " KB" << std::endl;
+    return true;
 }
 
-void DisplayManager::updateGifElement(DisplayElement& element) {
-    uint64_t current_time = getCurrentTimeUs();
+void DisplayManager::releaseFullscreenStream() {
+    fullscreen_reader.reset();
+    fullscreen_stream.reset();
+    fullscreen_frames.reset();
+    fullscreen_next_frame = 0;
+}
+
+void DisplayManager::showFullscreenFrame(size_t frame_index) {
+    LIV_PROFILE_SCOPE("stream_frame");
+    // The stream is sequential: rewind when going backwards, then skip forward
+    if (frame_index < fullscreen_next_frame) {
+        fullscreen_reader->Rewind();
+        fullscreen_next_frame = 0;
+    }
     
-    if (current_time - element.last_frame_time >= element.frame_delay_us) {
-        element.current_frame = (element.current_frame + 1) % element.gif_frames.size();
-        element.last_frame_time = current_time;
+    uint32_t delay_us = 0;
+    while (fullscreen_next_frame <= frame_index) {
+        if (!fullscreen_reader->GetNext(matrix_target->canvas(), &delay_us)) {
+            fullscreen_reader->Rewind();
+            fullscreen_next_frame = 0;
+            return;
+        }
+        fullscreen_next_frame++;
     }
+    
+    presentFrame();
+    canvas_overwritten = true;
 }
 
 void DisplayManager::updateTextElement(DisplayElement& element) {
@@ -625,21 +1164,27 @@ void DisplayManager::updateTextElement(DisplayElement& element) {
         if (current_time - element.last_blink_time >= blink_interval_us) {
             element.blink_visible = !element.blink_visible;  // Toggle visibility
             element.last_blink_time = current_time;
-            // Mark display as dirty to force redraw
-            display_dirty = true;
+            // Mark the text area as dirty to force redraw
+            markDirty(elementBounds(element));
         }
     }
     
     // Simple scrolling for long text
-    if (static_cast<int>(element.text.length() * element.font_size) > SCREEN_WIDTH - element.x) {
+    if (isScrollingText(element)) {
         if (current_time - element.last_scroll_time >= element.scroll_delay_us) {
             element.scroll_offset = (element.scroll_offset + 1) % 
-                                  (element.text.length() * element.font_size);
+                                  (utf8Length(element.text) * element.font_size);
             element.last_scroll_time = current_time;
+            markDirty(elementBounds(element));
         }
     }
 }
 
+bool DisplayManager::isScrollingText(const DisplayElement& element) const {
+    return element.type == DisplayElement::TEXT &&
+           static_cast<int>(utf8Length(element.text) * element.font_size) > SCREEN_WIDTH - element.x;
+}
+
 bool DisplayManager::isWithinBounds(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
     bool result = (x < SCREEN_WIDTH && y < SCREEN_HEIGHT && 
                    x + width <= SCREEN_WIDTH && y + height <= SCREEN_HEIGHT);
@@ -672,27 +1217,26 @@ void DisplayManager::clipToBounds(uint16_t& x, uint16_t& y, uint16_t& width, uin
     }
 }
 
-void DisplayManager::drawChar(char c, uint16_t x, uint16_t y, uint8_t font_size, 
-                             uint8_t color_index) {
-    if (!canvas) return;
-    
+int DisplayManager::drawChar(uint32_t c, uint16_t x, uint16_t y, uint8_t font_size, 
+                            Color8 color, Surface& target, const Rect& clip) {
     // Get character from BDF font
-    const BdfChar* bdf_char = bdf_font.getChar(static_cast<uint32_t>(c));
+    const BdfChar* bdf_char = bdf_font.getChar(c);
     if (!bdf_char) {
-        std::cout << "drawChar: No BDF char found for '" << c << "' (ASCII " << (int)c << ")" << std::endl;
+        std::cout << "drawChar: No BDF char found for U+" << std::hex << c << std::dec << std::endl;
         // Fallback: draw a simple rectangle for unknown characters
-        Color8 color = ColorPalette::getColor(color_index);
-        for (int sy = 0; sy < font_size * 7; sy++) {
-            for (int sx = 0; sx < font_size * 5; sx++) {
-                canvas->SetPixel(x + sx, y + sy, color.r, color.g, color.b);
+        Rect box = Rect(x, y, font_size * 5, font_size * 7).intersect(clip);
+        for (int py = box.y; py < box.bottom(); py++) {
+            for (int px = box.x; px < box.right(); px++) {
+                target.setPixel(px, py, color.r, color.g, color.b);
             }
         }
-        return;
+        return font_size * 6; // fallback spacing
     }
 
     
     
     // Debug prints removed for performance
+    const uint8_t* bitmap = bdf_font.glyphBitmap(bdf_char);
     int bytes_per_row = (bdf_char->width + 7) / 8;
     
     int pixels_drawn = 0;
@@ -704,22 +1248,18 @@ void DisplayManager::drawChar(char c, uint16_t x, uint16_t y, uint8_t font_size,
             int byte_index = row * bytes_per_row + col / 8;
             int bit_index = 7 - (col % 8); // BDF uses MSB first
             
-            if (byte_index < static_cast<int>(bdf_char->bitmap.size())) {
-                uint8_t byte_val = bdf_char->bitmap[byte_index];
-                if (byte_val & (1 << bit_index)) {
-                    // Draw pixel scaled by font_size
-                    for (int sy = 0; sy < font_size; sy++) {
-                        for (int sx = 0; sx < font_size; sx++) {
-                            int pixel_x = x + (col + bdf_char->x_offset) * font_size + sx;
-                            int pixel_y = y + (row + bdf_char->y_offset) * font_size + sy;
-                            
-                            // Check bounds
-                            if (pixel_x >= 0 && pixel_x < SCREEN_WIDTH && 
-                                pixel_y >= 0 && pixel_y < SCREEN_HEIGHT) {
-                                Color8 color = ColorPalette::getColor(color_index);
-                                canvas->SetPixel(pixel_x, pixel_y, color.r, color.g, color.b);
-                                pixels_drawn++;
-                            }
+            uint8_t byte_val = bitmap[byte_index];
+            if (byte_val & (1 << bit_index)) {
+                // Draw pixel scaled by font_size
+                for (int sy = 0; sy < font_size; sy++) {
+                    for (int sx = 0; sx < font_size; sx++) {
+                        int pixel_x = x + (col + bdf_char->x_offset) * font_size + sx;
+                        int pixel_y = y + (row + bdf_char->y_offset) * font_size + sy;
+                        
+                        // Check bounds
+                        if (clip.contains(pixel_x, pixel_y)) {
+                            target.setPixel(pixel_x, pixel_y, color.r, color.g, color.b);
+                            pixels_drawn++;
                         }
                     }
                 }
@@ -728,33 +1268,29 @@ void DisplayManager::drawChar(char c, uint16_t x, uint16_t y, uint8_t font_size,
     }
     
     // Debug print removed for performance
+    
+    return bdf_char->dwidth * font_size; // use DWIDTH for proper spacing
 }
 
 void DisplayManager::drawString(const std::string& str, uint16_t x, uint16_t y, 
-                               uint8_t font_size, uint8_t color_index) {
+                               uint8_t font_size, Color8 color, Surface& target, const Rect& clip,
+                               size_t start) {
     uint16_t current_x = x;
     
     // Debug print removed for performance
     
-    for (char c : str) {
+    for (size_t pos = start; pos < str.size();) {
         if (current_x >= SCREEN_WIDTH) break;
         
-        drawChar(c, current_x, y, font_size, color_index);
-        
-        // Get character width from BDF font
-        const BdfChar* bdf_char = bdf_font.getChar(static_cast<uint32_t>(c));
-        if (bdf_char) {
-            current_x += bdf_char->dwidth * font_size; // use DWIDTH for proper spacing
-        } else {
-            current_x += font_size * 6; // fallback spacing
-        }
+        current_x += drawChar(utf8Next(str, &pos), current_x, y, font_size, color, target, clip);
     }
 }
 
 uint64_t DisplayManager::getCurrentTimeUs() {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+    // Monotonic, so animation timing does not jump when the clock is set
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
 }
 
 uint32_t DisplayManager::calculateGifChecksum(const GifCommand* cmd) {
@@ -841,13 +1377,13 @@ void DisplayManager::processGifCommand(GifCommand* cmd) {
               << " (checksum=" << checksum << ")" << std::endl;
     
     std::string filename(cmd->filename);
-    bool success = addGifElement(filename, cmd->x_pos, cmd->y_pos, cmd->width, cmd->height, cmd->element_id);
+    bool success = addGifElement(filename, cmd->x_pos, cmd->y_pos, cmd->width, cmd->height, cmd->element_id, true);
     
     if (success) {
-        // Update cache with new checksum
+        // Update cache with new checksum; the response is sent once the
+        // loader finishes (and the checksum reset if decoding fails)
         command_cache.gif_checksums[cmd->element_id] = checksum;
-        std::cout << "GIF loaded successfully, cache updated" << std::endl;
-        serial_protocol.sendResponse(cmd->screen_id, RESP_OK);
+        std::cout << "GIF load started, cache updated" << std::endl;
     } else {
         std::cout << "Failed to load GIF" << std::endl;
         serial_protocol.sendResponse(cmd->screen_id, RESP_FILE_NOT_FOUND);
@@ -887,11 +1423,11 @@ void DisplayManager::processTextCommand(TextCommand* cmd) {
               << "' with font: " << font_name << " blink=" << cmd->blink_interval_ms 
               << "ms (checksum=" << checksum << ")" << std::endl;
     
-    // Convert RGB to 8-bit color index using fast lookup
-    uint8_t color_index = ColorPalette::rgbTo8bitFast(cmd->color_r, cmd->color_g, cmd->color_b);
+    // Resolve the device colour once; drawing uses it as is
+    Color8 color = ColorPalette::mapColor(cmd->color_r, cmd->color_g, cmd->color_b, color_mode);
     
     // Use font_size = 1 (no scaling, use native BDF font size)
-    bool success = addTextElement(text, cmd->x_pos, cmd->y_pos, 1, color_index, font_name, 
+    bool success = addTextElement(text, cmd->x_pos, cmd->y_pos, 1, color, font_name, 
                                   cmd->element_id, cmd->blink_interval_ms);
     
     if (success) {
@@ -903,8 +1439,6 @@ void DisplayManager::processTextCommand(TextCommand* cmd) {
         std::cout << "Failed to add text element" << std::endl;
         serial_protocol.sendResponse(cmd->screen_id, RESP_INVALID_PARAMS);
     }
-
-    canvas->SetPixel(1, 511, 255, 0, 0);
 }
 
 void DisplayManager::processClearCommand(ClearCommand* cmd) {
@@ -948,7 +1482,12 @@ void DisplayManager::processDeleteElementCommand(DeleteElementCommand* cmd) {
     
     std::cout << "Processing DELETE_ELEMENT command: element_id=" << (int)cmd->element_id << std::endl;
     
-    bool found = false;
+    // Cancel a GIF load still in progress for this ID
+    bool found = pending_gif_loads.erase(cmd->element_id) > 0;
+    if (found) {
+        command_cache.gif_checksums[cmd->element_id] = 0;
+    }
+    
     for (auto it = elements.begin(); it != elements.end(); ++it) {
         if (it->element_id == cmd->element_id) {
             // Clear cache for this element
@@ -961,8 +1500,8 @@ void DisplayManager::processDeleteElementCommand(DeleteElementCommand* cmd) {
             std::cout << "Deleting element ID=" << (int)cmd->element_id 
                       << " type=" << (it->type == DisplayElement::GIF ? "GIF" : "TEXT") << std::endl;
             
+            markElementChanged(elementBounds(*it));
             elements.erase(it);
-            display_dirty = true;
             found = true;
             break;
         }
@@ -1001,7 +1540,17 @@ void DisplayManager::processStatusCommand(StatusCommand* cmd) {
         return;
     }
     
-    std::string status = getStatus();
+    std::string status;
+    if (cmd->detail == STATUS_LATENCY) {
+        status = latency_stats.summary();
+    } else if ((cmd->detail & 0xF0) == STATUS_LATENCY_STAGES) {
+        status = latency_stats.stageSummary(cmd->detail & 0x0F);
+    } else {
+        status = getStatus();
+    }
+    
+    // Response data has to fit in one packet
+    status.resize(std::min(status.size(), (size_t)PROTOCOL_MAX_RESPONSE_DATA));
     serial_protocol.sendResponse(cmd->screen_id, RESP_OK, 
                                (const uint8_t*)status.c_str(), status.length());
 }
@@ -1020,19 +1569,23 @@ void DisplayManager::addDiagnosticElements() {
     std::cout << "Drawing diagnostic pattern: Full green matrix with ProGames..." << std::endl;
     
     // Clear canvas first
-    canvas->Clear();
+    {
+        LIV_PROFILE_SCOPE("clear");
+        render_target->clear();
+    }
     
-    canvas->SetPixel(0, 0, 200, 0, 0);
-    canvas->SetPixel(0, 191, 0, 200, 0);
+    render_target->setPixel(0, 0, 200, 0, 0);
+    render_target->setPixel(0, 191, 0, 200, 0);
     
     // For vertical screens, draw text vertically centered
     if (SCREEN_WIDTH > 100) {
-        canvas->SetPixel(0, 64*7, 0, 200, 0);        
-        canvas->SetPixel(0, 64*8, 0, 200, 0);        
+        render_target->setPixel(0, 64*7, 0, 200, 0);        
+        render_target->setPixel(0, 64*8, 0, 200, 0);        
     } 
     
     // Force immediate display
-    canvas = matrix->SwapOnVSync(canvas, 1);
+    presentFrame();
+    canvas_overwritten = true;
     
     std::cout << "Diagnostic pattern drawn - green matrix with ProGames in center" << std::endl;
 }
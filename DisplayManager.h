@@ -1,37 +1,22 @@
 #pragma once
 
 #include "led-matrix.h"
+#include "content-streamer.h"
+#include "RenderTarget.h"
 #include "SerialProtocol.h"
 #include "BdfFont.h"
-#include <Magick++.h>
+#include "ColorPalette.h"
+#include "FrameStore.h"
+#include "GifLoader.h"
+#include "SpscQueue.h"
+#include "DamageMap.h"
+#include "LatencyTrace.h"
 #include <vector>
 #include <string>
 #include <memory>
 #include <map>
-
-// 8-bit color palette for performance optimization
-struct Color8 {
-    uint8_t r, g, b;
-    Color8(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0) : r(red), g(green), b(blue) {}
-};
-
-// 8-bit color palette with 256 colors
-class ColorPalette {
-public:
-    static const int PALETTE_SIZE = 256;
-    static Color8 palette[PALETTE_SIZE];
-    static bool initialized;
-    
-    // Lookup table for fast RGB to 8-bit conversion
-    static uint8_t rgb_lookup[256][256][256];
-    static bool lookup_initialized;
-    
-    static void initialize();
-    static void initializeLookupTable();
-    static uint8_t rgbTo8bit(uint8_t r, uint8_t g, uint8_t b);
-    static uint8_t rgbTo8bitFast(uint8_t r, uint8_t g, uint8_t b);
-    static Color8 getColor(uint8_t index);
-};
+#include <atomic>
+#include <thread>
 
 struct DisplayElement {
     enum Type { GIF, TEXT };
@@ -41,17 +26,16 @@ struct DisplayElement {
     bool active;
     
     // For GIF elements
-    std::vector<Magick::Image> gif_frames;
+    std::shared_ptr<const FrameStore> gif_frames;  // Decoded once at load
     std::string filename;
     size_t current_frame;
-    uint64_t last_frame_time;
-    uint64_t frame_delay_us;
+    uint64_t anim_start_time;  // Monotonic time playback started, frames follow the GIF timeline
     
     // For text elements
     std::string text;
     std::string font_name; // BDF font file name
     uint8_t font_size;
-    uint8_t color_index; // 8-bit color index instead of RGB
+    Color8 color;        // Device colour (already palette-mapped in palette256 mode)
     uint64_t scroll_offset;
     uint64_t scroll_delay_us;
     uint64_t last_scroll_time;
@@ -62,12 +46,18 @@ struct DisplayElement {
     uint64_t last_blink_time;    // Last blink toggle time
     
     DisplayElement() : type(GIF), element_id(0), x(0), y(0), width(0), height(0), active(false),
-                      current_frame(0), last_frame_time(0), frame_delay_us(100000),
-                      font_size(1), color_index(255), // White color index
+                      current_frame(0), anim_start_time(0),
+                      font_size(1), color(255, 255, 255),
                       scroll_offset(0), scroll_delay_us(1000000), last_scroll_time(0),
                       blink_interval_ms(0), blink_visible(true), last_blink_time(0) {}
 };
 
+// A parsed command on its way from the serial thread to the render thread
+struct QueuedCommand {
+    void* command;
+    CommandTrace trace;
+};
+
 // Simple command cache for deduplication
 struct CommandCache {
     uint32_t gif_checksums[256];  // One checksum per element_id
@@ -83,18 +73,42 @@ struct CommandCache {
 
 class DisplayManager {
 public:
-    DisplayManager(rgb_matrix::RGBMatrix* matrix, bool swap_dimensions = false, uint8_t screen_id = 1);
+    // Draws into target (MatrixRenderTarget on the panels, a memory target
+    // headless); the screen size is the target's size
+    DisplayManager(RenderTarget* target, bool swap_dimensions = false, uint8_t screen_id = 1,
+                   ColorMode color_mode = COLOR_MODE_PALETTE256);
     ~DisplayManager();
     
-    // Initialize display manager
-    bool init(const std::string& serial_port = "/dev/ttyUSB0");
+    // Initialize display manager; with capture_file set, every byte read
+    // from the serial port is recorded there (see SerialCapture.h)
+    bool init(const std::string& serial_port = "/dev/ttyUSB0", const std::string& capture_file = "");
     
-    // Process serial commands
+    // Apply commands received by the serial thread (render thread only)
     void processSerialCommands();
     
+    // Parse bytes received at time_us (monotonic) and apply the commands
+    // right away, on the calling thread - for replaying a capture without
+    // init(). Returns the number of commands applied.
+    size_t replaySerialBytes(const uint8_t* data, size_t length, uint64_t time_us);
+    
     // Update display (call this in main loop)
     void updateDisplay();
     
+    // Monotonic time (us) of the next scheduled visual change: GIF frame,
+    // blink toggle or scroll step. UINT64_MAX if the screen is static.
+    uint64_t nextDeadlineUs();
+    
+    // Sleep until the next deadline, a queued command or a finished GIF load
+    // (poll on the command eventfd, a timerfd and the loader's eventfd).
+    // A signal handler that sets a flag for the main loop must also write
+    // to wakeFd(), or a signal landing just before poll() is not seen until
+    // the next event, which on a static screen may never come.
+    void waitForEvents();
+    
+    // eventfd waitForEvents() polls; writing a uint64_t 1 to it (async-
+    // signal-safe) wakes the main loop
+    int wakeFd() const { return command_notify_fd; }
+    
     // Clear entire screen
     void clearScreen();
     
@@ -104,13 +118,16 @@ public:
     // Set brightness
     void setBrightness(uint8_t brightness);
     
-    // Add GIF element
+    // Add GIF element - decoded in the background and swapped in on the
+    // next frame once ready; the element with the same ID (if any) stays on
+    // screen until then. Returns false if the request is rejected up front.
     bool addGifElement(const std::string& filename, uint16_t x, uint16_t y, 
-                      uint16_t width, uint16_t height, uint8_t element_id);
+                      uint16_t width, uint16_t height, uint8_t element_id,
+                      bool send_response = false);
     
     // Add text element
     bool addTextElement(const std::string& text, uint16_t x, uint16_t y,
-                       uint8_t font_size, uint8_t color_index, const std::string& font_name, 
+                       uint8_t font_size, Color8 color, const std::string& font_name, 
                        uint8_t element_id, uint16_t blink_interval_ms = 0);
     
     // Remove element at position
@@ -119,16 +136,38 @@ public:
     // Get status information
     std::string getStatus();
     
+    // Print the command latency histograms (SIGUSR1, render thread)
+    void dumpLatencyStats();
+    const LatencyStats& latencyStats() const { return latency_stats; }
+    
     // Add diagnostic elements for testing
     void addDiagnosticElements();
 
 private:
-    rgb_matrix::RGBMatrix* matrix;
-    rgb_matrix::FrameCanvas* canvas;
+    // liv-bench times the draw functions directly, liv-scene-bench feeds
+    // commands in and waits for the GIF loader
+    friend class RenderBenchmarks;
+    friend class SceneBenchmark;
+    
+    // Threading: the serial thread only reads the UART, parses packets and
+    // pushes commands into command_queue (serial_protocol's receive state is
+    // its own). Everything else - elements, caches, canvases - is scene and
+    // render state owned by the render thread, which applies the commands.
+    // Responses may be sent from both threads (SerialProtocol serializes them).
     SerialProtocol serial_protocol;
+    SpscQueue<QueuedCommand, 256> command_queue;  // Parsed commands, serial -> render thread
+    std::thread serial_thread;
+    std::atomic<bool> serial_thread_stop;
+    int command_notify_fd;  // eventfd: commands were queued
+    int serial_stop_fd;     // eventfd: wakes the serial thread for shutdown
+    static const uint64_t SERIAL_REOPEN_INTERVAL_US = 1000000;  // After a hang-up (USB unplugged)
+    
+    RenderTarget* render_target;
+    MatrixRenderTarget* matrix_target;  // render_target->asMatrix(), nullptr when headless
     std::vector<DisplayElement> elements;
     uint8_t current_brightness;
     uint8_t my_screen_id;  // This screen's ID
+    ColorMode color_mode;  // Colour pipeline for GIF frames and text
     uint64_t last_update_time;
     
     // BDF Font
@@ -140,21 +179,98 @@ private:
     // Command cache for deduplication
     CommandCache command_cache;
     
+    // Background GIF decoding
+    GifLoader gif_loader;
+    uint64_t next_load_ticket;
+    std::map<uint8_t, uint64_t> pending_gif_loads;  // element_id -> ticket of latest load
+    
+    // Render scheduling
+    int timer_fd;  // timerfd armed at nextDeadlineUs()
+    
+    // Command-to-photon latency: every command is timed from its first byte
+    // on the wire to the swap that shows it. Commands that changed the scene
+    // wait in awaiting_photon for the next swap; LOAD_GIF commands wait in
+    // gif_traces until their GIF is installed.
+    LatencyStats latency_stats;
+    std::vector<CommandTrace> awaiting_photon;
+    std::map<uint8_t, CommandTrace> gif_traces;  // element_id -> trace of the pending load
+    uint64_t scene_changes;  // Bumped by every markDirty()/markAllDirty()
+    
     // Diagnostic display flag
     bool diagnostic_drawn;
     
     // Display dirty flag - true when redraw is needed
     bool display_dirty;
     
+    // Damage-tracking compositor: elements are composed into compose_buffer
+    // and only the tiles that changed are redrawn and pushed to the canvas.
+    // The matrix double-buffers, so a tile is pushed in the frame it changed
+    // and again in the next one to bring the other canvas up to date.
+    Surface compose_buffer;
+    DamageMap damage;           // Changed since the last composed frame
+    DamageMap previous_damage;  // Changed in the composed frame before that
+    bool canvas_overwritten;    // Canvas drawn outside the compositor (diagnostic, stream)
+    
+    // Static-layer cache. Elements are drawn in z-order (GIFs, then text);
+    // static elements below the first animated one are kept pre-rendered in
+    // static_background, those above the last animated one in static_overlay.
+    // A frame copies the background, draws draw_order[live_begin, live_end)
+    // and lays the overlay on top. Rebuilt only when elements are added,
+    // changed or removed - animation steps do not touch the layers.
+    Surface static_background;
+    Surface static_overlay;           // Has a mask: only drawn pixels are laid over
+    bool static_layers_dirty;
+    std::vector<size_t> draw_order;   // Indices into elements, in z-order
+    size_t live_begin;
+    size_t live_end;
+    
+    // Full-screen GIF fast path: when a single GIF covers the whole screen,
+    // its frames are pre-rendered into a FrameCanvas stream and played back
+    // with a canvas copy instead of composing every frame
+    std::unique_ptr<rgb_matrix::MemStreamIO> fullscreen_stream;
+    std::unique_ptr<rgb_matrix::StreamReader> fullscreen_reader;
+    std::shared_ptr<const FrameStore> fullscreen_frames;  // Frames the stream was built from
+    std::weak_ptr<const FrameStore> fullscreen_rejected;  // Too large to pre-render
+    rgb_matrix::FrameCanvas* stream_scratch;               // Scratch canvas for pre-rendering
+    size_t fullscreen_next_frame;                          // Frame returned by the next GetNext()
+    uint8_t fullscreen_brightness;                         // Brightness baked into the stream
+    static const size_t FULLSCREEN_STREAM_MAX_BYTES = 32 * 1024 * 1024;
+    
     // Screen bounds (dynamically set based on matrix size)
     int SCREEN_WIDTH;
     int SCREEN_HEIGHT;
     
     // Helper functions
-    void drawGifElement(const DisplayElement& element);
-    void drawTextElement(const DisplayElement& element);
+    void drawGifElement(const DisplayElement& element, Surface& target, const Rect& clip);
+    void drawTextElement(const DisplayElement& element, Surface& target, const Rect& clip);
     void updateGifElement(DisplayElement& element);
     void updateTextElement(DisplayElement& element);
+    bool isScrollingText(const DisplayElement& element) const;
+    void applyLoadedGifs();
+    void installGifElement(const GifLoadRequest& request,
+                           const std::shared_ptr<const FrameStore>& frames);
+    
+    // Damage tracking
+    void markDirty(const Rect& area);
+    void markAllDirty();
+    void markElementChanged(const Rect& area);  // Also invalidates the static layers
+    bool isAnimated(const DisplayElement& element) const;
+    void rebuildStaticLayers();
+    Rect elementBounds(const DisplayElement& element);  // Screen area the element can draw to
+    BdfFont* textFont(const DisplayElement& element);   // nullptr = default 5x7 font
+    void composeDamage();
+    void flushToCanvas(const DamageMap& area);
+    
+    // Latency tracing
+    void presentFrame();           // Swap and stamp the commands it shows
+    void recordUnshownCommands();  // Nothing to swap after all (no visible change)
+    void finishGifTraces();        // Record traces of GIF loads that were cancelled
+    
+    // Full-screen stream fast path
+    DisplayElement* findFullscreenGif();
+    bool buildFullscreenStream(const DisplayElement& element);
+    void releaseFullscreenStream();
+    void showFullscreenFrame(size_t frame_index);
     
     // Checksum calculation for command deduplication
     uint32_t calculateGifChecksum(const GifCommand* cmd);
@@ -167,15 +283,24 @@ private:
     bool isWithinBounds(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
     void clipToBounds(uint16_t& x, uint16_t& y, uint16_t& width, uint16_t& height);
     
-    // Text rendering helpers
-    void drawChar(char c, uint16_t x, uint16_t y, uint8_t font_size, uint8_t color_index);
+    // Text rendering helpers (default font). Text is UTF-8; drawChar takes
+    // a code point and returns the advance in pixels, drawString starts at
+    // byte offset start.
+    int drawChar(uint32_t c, uint16_t x, uint16_t y, uint8_t font_size, Color8 color,
+                 Surface& target, const Rect& clip);
     void drawString(const std::string& str, uint16_t x, uint16_t y, 
-                   uint8_t font_size, uint8_t color_index);
+                   uint8_t font_size, Color8 color, Surface& target, const Rect& clip,
+                   size_t start = 0);
     
     // Time utilities
     uint64_t getCurrentTimeUs();
     
+    // Serial thread
+    void serialThreadMain();
+    void stopSerialThread();
+    
     // Command processing
+    void applyCommand(void* command, CommandTrace& trace);  // Dispatches and frees the command
     void processGifCommand(GifCommand* cmd);
     void processTextCommand(TextCommand* cmd);
     void processClearCommand(ClearCommand* cmd);
@@ -0,0 +1,163 @@
+#include "FrameProfiler.h"
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+uint64_t FrameProfiler::nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef LIV_PROFILE
+
+namespace {
+
+// One ring slot, a seqlock: seq is 0 while the slot is being written and
+// the event's ring position + 1 once complete. The fields are relaxed
+// atomics so the flush can read them while a writer overwrites the slot.
+struct ProfileSlot {
+    std::atomic<uint64_t> seq;
+    std::atomic<const char*> name;
+    std::atomic<const char*> type;
+    std::atomic<uint64_t> begin_ns;
+    std::atomic<uint64_t> end_ns;
+    std::atomic<int32_t> element_id;
+    std::atomic<uint32_t> thread;
+};
+
+struct ProfileEvent {
+    const char* name;
+    const char* type;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    int32_t element_id;
+    uint32_t thread;
+};
+
+const int MAX_THREADS = 16;
+
+ProfileSlot slots[FrameProfiler::CAPACITY];
+std::atomic<uint64_t> next_slot(0);
+std::atomic<uint32_t> next_thread(0);
+std::atomic<const char*> thread_names[MAX_THREADS];
+thread_local int thread_index = -1;
+
+uint32_t currentThread() {
+    if (thread_index < 0) {
+        thread_index = (int)(next_thread.fetch_add(1, std::memory_order_relaxed) % MAX_THREADS);
+    }
+    return (uint32_t)thread_index;
+}
+
+}  // namespace
+
+bool FrameProfiler::compiledIn() {
+    return true;
+}
+
+void FrameProfiler::record(const char* name, uint64_t begin_ns, uint64_t end_ns,
+                           int element_id, const char* type) {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+    const uint64_t position = next_slot.fetch_add(1, std::memory_order_relaxed);
+    ProfileSlot& slot = slots[position & (CAPACITY - 1)];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.type.store(type, std::memory_order_relaxed);
+    slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    slot.end_ns.store(end_ns, std::memory_order_relaxed);
+    slot.element_id.store(element_id, std::memory_order_relaxed);
+    slot.thread.store(currentThread(), std::memory_order_relaxed);
+    slot.seq.store(position + 1, std::memory_order_release);
+}
+
+void FrameProfiler::setThreadName(const char* name) {
+    thread_names[currentThread()].store(name, std::memory_order_relaxed);
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) {
+    // Snapshot the ring, skipping slots a writer is in the middle of
+    std::vector<ProfileEvent> events;
+    events.reserve(CAPACITY);
+    for (size_t i = 0; i < CAPACITY; i++) {
+        const ProfileSlot& slot = slots[i];
+        const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == 0) continue;
+
+        ProfileEvent event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.type = slot.type.load(std::memory_order_relaxed);
+        event.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+        event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+        event.element_id = slot.element_id.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+        events.push_back(event);
+    }
+    std::sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+        return a.begin_ns < b.begin_ns;
+    });
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Cannot write trace " << path << std::endl;
+        return false;
+    }
+
+    // Complete ("X") events, timestamps in microseconds
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"liv\"}}");
+    const uint32_t threads = std::min<uint32_t>(next_thread.load(), MAX_THREADS);
+    for (uint32_t t = 0; t < threads; t++) {
+        const char* name = thread_names[t].load(std::memory_order_relaxed);
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                t, name ? name : "thread");
+    }
+    for (const ProfileEvent& event : events) {
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"render\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f",
+                event.name ? event.name : "?", event.thread, event.begin_ns / 1000.0,
+                (event.end_ns > event.begin_ns ? event.end_ns - event.begin_ns : 0) / 1000.0);
+        if (event.element_id >= 0) {
+            fprintf(file, ",\"args\":{\"element_id\":%d,\"type\":\"%s\"}",
+                    event.element_id, event.type ? event.type : "");
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        std::cerr << "Cannot write trace " << path << std::endl;
+        return false;
+    }
+    std::cout << "Profiler: wrote " << events.size() << " events to " << path << std::endl;
+    return true;
+}
+
+#else  // !LIV_PROFILE
+
+bool FrameProfiler::compiledIn() {
+    return false;
+}
+
+void FrameProfiler::record(const char* name, uint64_t begin_ns, uint64_t end_ns,
+                           int element_id, const char* type) {
+}
+
+void FrameProfiler::setThreadName(const char* name) {
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) {
+    std::cerr << "Profiler not compiled in, rebuild with cmake -DLIV_PROFILE=ON" << std::endl;
+    return false;
+}
+
+#endif  // LIV_PROFILE
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Render-stage profiler: timed scopes (frame, command, element update, each
+// element draw, flush, clear, swap, GIF decode, serial reads) recorded into
+// a fixed lock-free ring and written out as a Chrome trace-event JSON file
+// for chrome://tracing or ui.perfetto.dev.
+//
+// Compiled in only with LIV_PROFILE defined (cmake -DLIV_PROFILE=ON); in a
+// normal build the LIV_PROFILE_* macros expand to nothing and
+// writeChromeTrace() reports that profiling is not compiled in.
+class FrameProfiler {
+public:
+    // Newest events kept; older ones are overwritten (~3 MB of ring)
+    static const size_t CAPACITY = 65536;
+
+    static bool compiledIn();
+
+    // Record a finished scope. name and type must be string literals (only
+    // the pointers are stored); element_id < 0 = not about an element.
+    static void record(const char* name, uint64_t begin_ns, uint64_t end_ns,
+                       int element_id = -1, const char* type = nullptr);
+
+    // Name the calling thread in the trace ("render", "serial", ...)
+    static void setThreadName(const char* name);
+
+    // Write the events currently in the ring; safe while other threads
+    // keep recording (events being written at that moment are skipped)
+    static bool writeChromeTrace(const std::string& path);
+
+    static uint64_t nowNs();
+};
+
+// Times the enclosing block
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name, int element_id = -1, const char* type = nullptr)
+        : name(name), type(type), element_id(element_id), begin_ns(FrameProfiler::nowNs()) {}
+    ~ProfileScope() { FrameProfiler::record(name, begin_ns, FrameProfiler::nowNs(), element_id, type); }
+
+private:
+    const char* name;
+    const char* type;
+    int element_id;
+    uint64_t begin_ns;
+};
+
+#ifdef LIV_PROFILE
+#define LIV_PROFILE_CONCAT_INNER(a, b) a##b
+#define LIV_PROFILE_CONCAT(a, b) LIV_PROFILE_CONCAT_INNER(a, b)
+#define LIV_PROFILE_SCOPE(name) ProfileScope LIV_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define LIV_PROFILE_ELEMENT_SCOPE(name, element_id, type) \
+    ProfileScope LIV_PROFILE_CONCAT(profile_scope_, __LINE__)(name, element_id, type)
+#define LIV_PROFILE_THREAD(name) FrameProfiler::setThreadName(name)
+#else
+#define LIV_PROFILE_SCOPE(name) do {} while (0)
+#define LIV_PROFILE_ELEMENT_SCOPE(name, element_id, type) do {} while (0)
+#define LIV_PROFILE_THREAD(name) do {} while (0)
+#endif
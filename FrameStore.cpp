@@ -0,0 +1,274 @@
+#include "FrameStore.h"
+#include "ColorPalette.h"
+#include "RowKernels.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Frame file layout (host byte order, files are built on the target itself):
+//   FrameFileHeader
+//   uint32_t delay_us[frame_count]
+//   padding up to data_offset (FRAME_FILE_ALIGN)
+//   RGB planes:  frame_count * width * height * 3
+//   mask planes: frame_count * mask_stride * height
+struct FrameFileHeader {
+    char magic[4];             // "LIVF"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_count;
+    uint32_t mask_stride;
+    uint32_t color_mode;       // ColorMode the RGB planes were built in
+    uint32_t reserved;
+    uint64_t source_mtime_ns;  // GIF the frames were decoded from
+    uint64_t source_size;
+    uint64_t data_offset;      // Start of the RGB planes
+};
+
+static const char FRAME_FILE_MAGIC[4] = {'L', 'I', 'V', 'F'};
+static const uint32_t FRAME_FILE_VERSION = 2;
+static const size_t FRAME_FILE_ALIGN = 64;
+
+// Frames with no delay are shown for 100 ms, like most GIF players do
+static const uint32_t DEFAULT_FRAME_DELAY_US = 100000;
+
+FrameStore::~FrameStore() {
+    if (mapped) {
+        munmap(mapped, mapped_size);
+    }
+}
+
+std::shared_ptr<FrameStore> FrameStore::fromImages(const std::vector<Magick::Image>& images,
+                                                   ColorMode mode) {
+    if (images.empty()) return nullptr;
+
+    std::shared_ptr<FrameStore> store(new FrameStore());
+    store->frame_width = images[0].columns();
+    store->frame_height = images[0].rows();
+    store->mask_stride = (store->frame_width + 7) / 8;
+    store->color_mode = mode;
+
+    const size_t rgb_size = (size_t)store->frame_width * store->frame_height * 3;
+    const size_t mask_size = store->mask_stride * store->frame_height;
+    const size_t count = images.size();
+
+    // One allocation for the whole animation: RGB planes first, then masks
+    store->storage.assign(count * (rgb_size + mask_size), 0);
+    uint8_t* rgb_base = store->storage.data();
+    uint8_t* mask_base = rgb_base + count * rgb_size;
+
+    ColorPalette::initialize();
+    std::vector<uint8_t> row_indices(store->frame_width);
+    
+    store->frames.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const Magick::Image& img = images[i];
+        uint8_t* rgb = rgb_base + i * rgb_size;
+        uint8_t* mask = mask_base + i * mask_size;
+
+        // Coalesced frames all have the same size; clip defensively anyway
+        const int rows = std::min((int)img.rows(), store->frame_height);
+        const int cols = std::min((int)img.columns(), store->frame_width);
+
+        for (int y = 0; y < rows; y++) {
+            const Magick::PixelPacket* src = img.getConstPixels(0, y, cols, 1);
+            if (!src) continue;
+
+            uint8_t* dst = rgb + (size_t)y * store->frame_width * 3;
+            uint8_t* mask_row = mask + (size_t)y * store->mask_stride;
+            if (mode == COLOR_MODE_TRUECOLOR) {
+                for (int x = 0; x < cols; x++) {
+                    // Transparent pixels stay black, like the zeroed storage
+                    if (src[x].opacity < 255) {
+                        dst[x * 3 + 0] = ScaleQuantumToChar(src[x].red);
+                        dst[x * 3 + 1] = ScaleQuantumToChar(src[x].green);
+                        dst[x * 3 + 2] = ScaleQuantumToChar(src[x].blue);
+                        mask_row[x >> 3] |= (uint8_t)(0x80 >> (x & 7));
+                    }
+                }
+                continue;
+            }
+
+            for (int x = 0; x < cols; x++) {
+                // Same transparency test and colour mapping drawGifElement
+                // used to do per pixel, per frame
+                if (src[x].opacity < 255) {
+                    row_indices[x] = ColorPalette::rgbTo8bitFast(
+                        ScaleQuantumToChar(src[x].red),
+                        ScaleQuantumToChar(src[x].green),
+                        ScaleQuantumToChar(src[x].blue));
+                    mask_row[x >> 3] |= (uint8_t)(0x80 >> (x & 7));
+                } else {
+                    row_indices[x] = 0; // Black, like the zeroed storage
+                }
+            }
+            rowKernels().expand_palette(dst, row_indices.data(), cols, ColorPalette::packed);
+        }
+
+        PackedFrame& frame = store->frames[i];
+        frame.rgb = rgb;
+        frame.mask = mask;
+        // animationDelay() is in 1/100 s
+        frame.delay_us = img.animationDelay() * 10000;
+    }
+
+    store->buildTimeline();
+    return store;
+}
+
+void FrameStore::buildTimeline() {
+    frame_end_us.resize(frames.size());
+    total_duration_us = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        uint32_t delay_us = frames[i].delay_us;
+        if (delay_us == 0) delay_us = DEFAULT_FRAME_DELAY_US;
+        total_duration_us += delay_us;
+        frame_end_us[i] = total_duration_us;
+    }
+}
+
+size_t FrameStore::frameAt(uint64_t elapsed_us) const {
+    if (frames.size() <= 1 || total_duration_us == 0) return 0;
+
+    // First frame that ends after the position within the current loop
+    const uint64_t position = elapsed_us % total_duration_us;
+    return std::upper_bound(frame_end_us.begin(), frame_end_us.end(), position) - frame_end_us.begin();
+}
+
+uint64_t FrameStore::timeToNextFrame(uint64_t elapsed_us) const {
+    if (frames.size() <= 1 || total_duration_us == 0) return UINT64_MAX;
+
+    const uint64_t position = elapsed_us % total_duration_us;
+    return frame_end_us[frameAt(elapsed_us)] - position;
+}
+
+std::shared_ptr<FrameStore> FrameStore::mapFile(const std::string& path,
+                                                uint64_t source_mtime_ns,
+                                                uint64_t source_size,
+                                                ColorMode mode) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FrameFileHeader)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    const size_t file_size = st.st_size;
+    void* data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return nullptr;
+
+    // Owns the mapping from here on, so every early return unmaps it
+    std::shared_ptr<FrameStore> store(new FrameStore());
+    store->mapped = data;
+    store->mapped_size = file_size;
+
+    FrameFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FRAME_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FRAME_FILE_VERSION) {
+        std::cerr << "Frame file " << path << " has wrong format, ignoring" << std::endl;
+        return nullptr;
+    }
+    if (header.source_mtime_ns != source_mtime_ns || header.source_size != source_size) {
+        return nullptr; // Source GIF changed since the file was built
+    }
+    if (header.color_mode != (uint32_t)mode) {
+        return nullptr; // Built for a screen with the other colour mode
+    }
+
+    // Checked in 64 bits and by division: with a 32-bit size_t (Pi OS) a
+    // corrupt header could wrap a product back under file_size. A frame
+    // has at least 3 file bytes per pixel, so every plane size below
+    // fits in size_t once the pixel count is known not to exceed file_size.
+    const uint64_t pixels = (uint64_t)header.width * header.height;
+    if (header.frame_count == 0 || pixels == 0 || pixels > file_size ||
+        header.mask_stride != (header.width + 7) / 8 ||
+        header.data_offset < sizeof(header) + (uint64_t)header.frame_count * sizeof(uint32_t) ||
+        header.data_offset > file_size ||
+        header.frame_count > (file_size - header.data_offset) /
+                             (pixels * 3 + (uint64_t)header.mask_stride * header.height)) {
+        std::cerr << "Frame file " << path << " is truncated or corrupt, ignoring" << std::endl;
+        return nullptr;
+    }
+    const size_t rgb_size = (size_t)pixels * 3;
+    const size_t mask_size = (size_t)header.mask_stride * header.height;
+
+    store->frame_width = header.width;
+    store->frame_height = header.height;
+    store->mask_stride = header.mask_stride;
+    store->color_mode = mode;
+
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    const uint8_t* delays = base + sizeof(header);
+    const uint8_t* rgb_base = base + header.data_offset;
+    const uint8_t* mask_base = rgb_base + header.frame_count * rgb_size;
+
+    store->frames.resize(header.frame_count);
+    for (size_t i = 0; i < header.frame_count; i++) {
+        PackedFrame& frame = store->frames[i];
+        frame.rgb = rgb_base + i * rgb_size;
+        frame.mask = mask_base + i * mask_size;
+        memcpy(&frame.delay_us, delays + i * sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    store->buildTimeline();
+    return store;
+}
+
+bool FrameStore::writeFile(const std::string& path, uint64_t source_mtime_ns,
+                           uint64_t source_size) const {
+    FrameFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_FILE_MAGIC, sizeof(header.magic));
+    header.version = FRAME_FILE_VERSION;
+    header.width = frame_width;
+    header.height = frame_height;
+    header.frame_count = frames.size();
+    header.mask_stride = mask_stride;
+    header.color_mode = color_mode;
+    header.source_mtime_ns = source_mtime_ns;
+    header.source_size = source_size;
+
+    const size_t table_end = sizeof(header) + frames.size() * sizeof(uint32_t);
+    header.data_offset = (table_end + FRAME_FILE_ALIGN - 1) / FRAME_FILE_ALIGN * FRAME_FILE_ALIGN;
+
+    // Write to a temporary file and rename, so a reader never maps a half
+    // written file (another screen process may be loading the same asset)
+    const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; ok && i < frames.size(); i++) {
+        ok = fwrite(&frames[i].delay_us, sizeof(uint32_t), 1, file) == 1;
+    }
+    static const uint8_t padding[FRAME_FILE_ALIGN] = {0};
+    if (ok && header.data_offset > table_end) {
+        ok = fwrite(padding, header.data_offset - table_end, 1, file) == 1;
+    }
+
+    const size_t rgb_size = (size_t)frame_width * frame_height * 3;
+    const size_t mask_size = mask_stride * frame_height;
+    for (size_t i = 0; ok && i < frames.size(); i++) {
+        ok = fwrite(frames[i].rgb, 1, rgb_size, file) == rgb_size;
+    }
+    for (size_t i = 0; ok && i < frames.size(); i++) {
+        ok = fwrite(frames[i].mask, 1, mask_size, file) == mask_size;
+    }
+
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(tmp_path.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        unlink(tmp_path.c_str());
+        std::cerr << "Failed to write frame file " << path << std::endl;
+    }
+    return ok;
+}
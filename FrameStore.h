@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ColorPalette.h"
+#include <Magick++.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <memory>
+#include <string>
+
+// One decoded animation frame in device-ready form.
+// rgb:  width*height*3 bytes, final device colour (palette-mapped or
+//       true colour, see FrameStore::colorMode()), row-major
+// mask: one bit per pixel, MSB first (same layout as BDF bitmaps), 1 = opaque
+struct PackedFrame {
+    const uint8_t* rgb;
+    const uint8_t* mask;
+    uint32_t delay_us;     // GIF frame delay in microseconds
+};
+
+// All frames of one GIF, decoded once into a single contiguous buffer.
+// Replaces keeping coalesced Magick::Image frames (16-bit RGBA per pixel)
+// alive for the lifetime of a display element.
+//
+// A FrameStore can be saved as a binary frame file (header, per-frame delay
+// table, RGB planes, mask planes) and later mapped read-only with mmap and
+// used in place, without any parsing or decoding.
+class FrameStore {
+public:
+    ~FrameStore();
+
+    // Convert coalesced + scaled frames (result of LoadImageAndScale).
+    // In COLOR_MODE_PALETTE256 colours are quantized to ColorPalette, in
+    // COLOR_MODE_TRUECOLOR they are kept as 8-bit RGB.
+    // Returns nullptr if there are no frames.
+    static std::shared_ptr<FrameStore> fromImages(const std::vector<Magick::Image>& images,
+                                                  ColorMode mode);
+
+    // Map a frame file written by writeFile(). Returns nullptr if the file is
+    // missing, malformed, holds another colour mode, or was built from a
+    // different version of the source (source_mtime_ns / source_size do not match).
+    static std::shared_ptr<FrameStore> mapFile(const std::string& path,
+                                               uint64_t source_mtime_ns,
+                                               uint64_t source_size,
+                                               ColorMode mode);
+
+    // Write the frames to path (via a temporary file and rename)
+    bool writeFile(const std::string& path, uint64_t source_mtime_ns,
+                   uint64_t source_size) const;
+
+    int width() const { return frame_width; }
+    int height() const { return frame_height; }
+    size_t frameCount() const { return frames.size(); }
+    const PackedFrame& frame(size_t index) const { return frames[index]; }
+    size_t maskStride() const { return mask_stride; }
+    ColorMode colorMode() const { return color_mode; }
+
+    // Playback timeline built from each frame's own delay
+    uint64_t durationUs() const { return total_duration_us; }
+    size_t frameAt(uint64_t elapsed_us) const;
+    // Time from elapsed_us until the displayed frame changes (UINT64_MAX for stills)
+    uint64_t timeToNextFrame(uint64_t elapsed_us) const;
+
+    // Bytes held by pixel and mask planes
+    size_t memoryBytes() const { return mapped ? mapped_size : storage.size(); }
+
+    // True if the frames live in a mapped frame file
+    bool isMapped() const { return mapped != nullptr; }
+
+private:
+    FrameStore() : frame_width(0), frame_height(0), mask_stride(0),
+                   color_mode(COLOR_MODE_PALETTE256), total_duration_us(0), mapped(nullptr), mapped_size(0) {}
+    FrameStore(const FrameStore&) = delete;
+    FrameStore& operator=(const FrameStore&) = delete;
+
+    void buildTimeline();
+
+    int frame_width;
+    int frame_height;
+    size_t mask_stride;            // bytes per mask row: (width + 7) / 8
+    ColorMode color_mode;
+    std::vector<uint8_t> storage;  // all RGB planes followed by all mask planes
+    std::vector<PackedFrame> frames;
+    std::vector<uint64_t> frame_end_us;  // Cumulative end time of each frame
+    uint64_t total_duration_us;
+    void* mapped;                  // Frame file mapping (instead of storage)
+    size_t mapped_size;
+};
@@ -0,0 +1,138 @@
+#include "GifLoader.h"
+#include "LedImgViewer.h"
+#include "AssetCache.h"
+#include "DiskFrameCache.h"
+#include "FrameProfiler.h"
+#include <sys/eventfd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <iostream>
+
+GifLoader::GifLoader() : in_progress(0), stopping(false) {
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify_fd < 0) {
+        perror("eventfd");
+    }
+    worker = std::thread(&GifLoader::run, this);
+}
+
+GifLoader::~GifLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    work_available.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    if (notify_fd >= 0) {
+        close(notify_fd);
+    }
+}
+
+void GifLoader::submit(const GifLoadRequest& request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(request);
+    }
+    work_available.notify_one();
+}
+
+bool GifLoader::poll(GifLoadResult* result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (completed.empty()) return false;
+
+    *result = std::move(completed.front());
+    completed.pop_front();
+    return true;
+}
+
+void GifLoader::drainNotifications() {
+    uint64_t count;
+    if (notify_fd >= 0 && read(notify_fd, &count, sizeof(count)) < 0) {
+        // EAGAIN - nothing to drain
+    }
+}
+
+size_t GifLoader::pendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size() + in_progress;
+}
+
+std::shared_ptr<const FrameStore> GifLoader::decode(const std::string& filename,
+                                                    int width, int height,
+                                                    ColorMode mode,
+                                                    std::string* err_msg) {
+    // Frames baked earlier (by us or liv-assetc) are mapped without decoding
+    std::shared_ptr<const FrameStore> cached = DiskFrameCache::load(filename, width, height, mode);
+    if (cached) {
+        return cached;
+    }
+
+    std::vector<Magick::Image> images;
+    if (!LoadImageAndScale(filename.c_str(), width, height, false, false, &images, err_msg)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const FrameStore> frames = FrameStore::fromImages(images, mode);
+    if (!frames) {
+        *err_msg = "no frames decoded";
+        return nullptr;
+    }
+
+    DiskFrameCache::store(filename, width, height, *frames);
+    return frames;
+}
+
+void GifLoader::run() {
+    // Leave SIGINT/SIGTERM/SIGHUP/SIGUSR1/SIGUSR2 to the main thread so they interrupt its poll()
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    LIV_PROFILE_THREAD("gif-loader");
+
+    while (true) {
+        GifLoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+
+            request = queue.front();
+            queue.pop_front();
+            in_progress++;
+        }
+
+        GifLoadResult result;
+        result.request = request;
+        {
+            LIV_PROFILE_ELEMENT_SCOPE("gif.load", request.element_id, "GIF");
+            result.frames = AssetCache::instance().find(request.filename, request.width, request.height,
+                                                        request.color_mode);
+            if (!result.frames) {
+                result.frames = decode(request.filename, request.width, request.height,
+                                       request.color_mode, &result.error);
+                AssetCache::instance().insert(request.filename, request.width, request.height, result.frames);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_progress--;
+            completed.push_back(std::move(result));
+        }
+
+        // Wake up the render loop
+        uint64_t one = 1;
+        if (notify_fd >= 0 && write(notify_fd, &one, sizeof(one)) < 0) {
+            perror("eventfd write");
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FrameStore.h"
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+// A GIF element waiting to be decoded
+struct GifLoadRequest {
+    uint64_t ticket;       // Identifies the load, newer loads get larger tickets
+    std::string filename;
+    uint16_t x, y, width, height;
+    ColorMode color_mode;  // Colour mode of the screen the frames are for
+    uint8_t element_id;
+    uint8_t screen_id;     // Screen to answer on
+    bool send_response;    // Answer over serial when the load completes
+
+    GifLoadRequest() : ticket(0), x(0), y(0), width(0), height(0),
+                       color_mode(COLOR_MODE_PALETTE256), element_id(0), screen_id(0), send_response(false) {}
+};
+
+// A finished load; frames is null on failure and error says why
+struct GifLoadResult {
+    GifLoadRequest request;
+    std::shared_ptr<const FrameStore> frames;
+    std::string error;
+};
+
+// Decodes GIFs (readImages, coalesceImages, scale, pack) on a worker thread
+// so the render loop keeps running while a large file loads. Finished loads
+// are collected with poll() from the thread that owns the display elements.
+class GifLoader {
+public:
+    GifLoader();
+    ~GifLoader();
+
+    // Queue a load, returns immediately
+    void submit(const GifLoadRequest& request);
+
+    // Take one finished load, returns false if none is ready
+    bool poll(GifLoadResult* result);
+
+    // Loads queued or in progress
+    size_t pendingCount();
+
+    // eventfd that becomes readable when a load finishes, for poll()
+    int notifyFd() const { return notify_fd; }
+
+    // Reset notifyFd() after it was reported readable
+    void drainNotifications();
+
+    // Decode a GIF synchronously on the calling thread (mapping the frame
+    // file from DiskFrameCache instead if there is an up to date one)
+    static std::shared_ptr<const FrameStore> decode(const std::string& filename,
+                                                    int width, int height,
+                                                    ColorMode mode,
+                                                    std::string* err_msg);
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::deque<GifLoadRequest> queue;
+    std::deque<GifLoadResult> completed;
+    size_t in_progress;
+    bool stopping;
+    int notify_fd;
+
+    void run();
+};
@@ -0,0 +1,168 @@
+#include "LatencyTrace.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+void LatencyHistogram::clear() {
+    memset(counts, 0, sizeof(counts));
+    total_count = 0;
+    sum_us = 0;
+    max_us = 0;
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value_us) {
+    if (value_us < SUB_BUCKETS) {
+        return (int)value_us;
+    }
+    // Top 4 bits of the value: the power of two and the 3-bit sub-bucket
+    const int msb = 63 - __builtin_clzll(value_us);
+    const int index = (msb - 2) * SUB_BUCKETS + (int)((value_us >> (msb - 3)) & (SUB_BUCKETS - 1));
+    return std::min(index, BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    const int shift = index / SUB_BUCKETS - 1;
+    const uint64_t lower = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_us) {
+    counts[bucketIndex(value_us)]++;
+    total_count++;
+    sum_us += value_us;
+    max_us = std::max(max_us, value_us);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (total_count == 0) return 0;
+
+    // Nearest rank, like the benchmarks
+    uint64_t rank = (uint64_t)(p / 100.0 * total_count + 0.999999);
+    rank = std::min(total_count, std::max<uint64_t>(rank, 1));
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The last bucket also holds everything above the range
+            return i == BUCKETS - 1 ? max_us : std::min(bucketUpperBound(i), max_us);
+        }
+    }
+    return max_us;
+}
+
+void LatencyStats::record(const CommandTrace& trace) {
+    LatencyHistogram* type = histograms[typeIndex(trace.command)];
+
+    // A stage counts only when the command got through both of its ends
+    const uint64_t stamps[] = {trace.received_us, trace.validated_us, trace.dequeued_us,
+                               trace.applied_us, trace.shown_us};
+    for (int stage = STAGE_SERIAL; stage <= STAGE_RENDER; stage++) {
+        const uint64_t begin = stamps[stage];
+        const uint64_t end = stamps[stage + 1];
+        if (begin && end) {
+            type[stage].record(end > begin ? end - begin : 0);
+        }
+    }
+    if (trace.received_us && trace.shown_us) {
+        type[STAGE_TOTAL].record(trace.shown_us > trace.received_us ? trace.shown_us - trace.received_us : 0);
+    }
+}
+
+void LatencyStats::clear() {
+    for (int type = 0; type < COMMAND_TYPES; type++) {
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            histograms[type][stage].clear();
+        }
+    }
+}
+
+const LatencyHistogram& LatencyStats::histogram(uint8_t command, Stage stage) const {
+    return histograms[typeIndex(command)][stage];
+}
+
+std::string LatencyStats::summary() const {
+    std::ostringstream out;
+    out << "total p50/p99 us:";
+    bool any = false;
+    for (int type = 1; type < COMMAND_TYPES; type++) {
+        const LatencyHistogram& total = histograms[type][STAGE_TOTAL];
+        if (total.count() == 0) continue;
+        out << " " << commandName(type) << " " << total.percentile(50) << "/" << total.percentile(99);
+        any = true;
+    }
+    if (!any) {
+        out << " none";
+    }
+    return out.str();
+}
+
+std::string LatencyStats::stageSummary(uint8_t command) const {
+    const LatencyHistogram* type = histograms[typeIndex(command)];
+
+    uint64_t commands = 0;
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        commands = std::max(commands, type[stage].count());
+    }
+
+    std::ostringstream out;
+    out << commandName(command) << " n=" << commands;
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        if (type[stage].count() == 0) continue;
+        out << " " << stageName((Stage)stage) << " " << type[stage].percentile(50)
+            << "/" << type[stage].percentile(99);
+    }
+    return out.str();
+}
+
+void LatencyStats::dump(std::ostream& out) const {
+    out << "=== Command latency (us) ===" << std::endl;
+    out << std::left << std::setw(16) << "command" << std::setw(8) << "stage" << std::right
+        << std::setw(8) << "count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(10) << "max" << std::setw(10) << "mean" << std::endl;
+
+    bool any = false;
+    for (int type = 0; type < COMMAND_TYPES; type++) {
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            const LatencyHistogram& histogram = histograms[type][stage];
+            if (histogram.count() == 0) continue;
+            out << std::left << std::setw(16) << commandName(type) << std::setw(8) << stageName((Stage)stage)
+                << std::right << std::setw(8) << histogram.count()
+                << std::setw(10) << histogram.percentile(50) << std::setw(10) << histogram.percentile(99)
+                << std::setw(10) << histogram.max() << std::setw(10) << histogram.mean() << std::endl;
+            any = true;
+        }
+    }
+    if (!any) {
+        out << "(no commands yet)" << std::endl;
+    }
+}
+
+const char* LatencyStats::stageName(Stage stage) {
+    switch (stage) {
+        case STAGE_SERIAL: return "serial";
+        case STAGE_QUEUE:  return "queue";
+        case STAGE_APPLY:  return "apply";
+        case STAGE_RENDER: return "render";
+        case STAGE_TOTAL:  return "total";
+        default:           return "?";
+    }
+}
+
+const char* LatencyStats::commandName(uint8_t command) {
+    // Values of CommandType (SerialProtocol.h)
+    switch (command) {
+        case 0x01: return "LOAD_GIF";
+        case 0x02: return "DISPLAY_TEXT";
+        case 0x03: return "CLEAR_SCREEN";
+        case 0x04: return "SET_BRIGHTNESS";
+        case 0x05: return "GET_STATUS";
+        case 0x06: return "CLEAR_TEXT";
+        case 0x07: return "DELETE_ELEMENT";
+        default:   return "UNKNOWN";
+    }
+}
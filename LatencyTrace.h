@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+
+// Monotonic timestamps (us) of one command on its way from the UART to the
+// panels; 0 = the command never reached that stage (ignored, rejected, no
+// visible change)
+struct CommandTrace {
+    uint8_t command;        // CommandType
+    uint64_t received_us;   // First byte of the packet read from the port
+    uint64_t validated_us;  // Packet passed the checksum and was parsed
+    uint64_t dequeued_us;   // Taken off the command queue by the render thread
+    uint64_t applied_us;    // Scene changed (for LOAD_GIF: decoded GIF installed)
+    uint64_t shown_us;      // First swap showing the change returned
+
+    CommandTrace() : command(0), received_us(0), validated_us(0), dequeued_us(0),
+                     applied_us(0), shown_us(0) {}
+};
+
+// Log-linear histogram of microsecond values: exact below 8 us, above that
+// 8 buckets per power of two (at most 12.5% off), up to ~71 minutes.
+// Fixed size, no allocation - recording is an increment.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKETS = 8;
+    static const int BUCKETS = SUB_BUCKETS + 29 * SUB_BUCKETS;
+
+    LatencyHistogram() { clear(); }
+
+    void clear();
+    void record(uint64_t value_us);
+
+    uint64_t count() const { return total_count; }
+    uint64_t max() const { return max_us; }
+    uint64_t mean() const { return total_count ? sum_us / total_count : 0; }
+
+    // Upper bound of the bucket holding the p-th percentile (never above max)
+    uint64_t percentile(double p) const;
+
+private:
+    static int bucketIndex(uint64_t value_us);
+    static uint64_t bucketUpperBound(int index);
+
+    uint32_t counts[BUCKETS];
+    uint64_t total_count;
+    uint64_t sum_us;
+    uint64_t max_us;
+};
+
+// Per command type and per stage latency histograms, fed by the render
+// thread (not thread-safe)
+class LatencyStats {
+public:
+    enum Stage {
+        STAGE_SERIAL,   // received -> validated: rest of the packet on the wire, parsing
+        STAGE_QUEUE,    // validated -> dequeued: waiting for the render thread
+        STAGE_APPLY,    // dequeued -> applied: command handler (LOAD_GIF: decode too)
+        STAGE_RENDER,   // applied -> shown: compose, flush and swap
+        STAGE_TOTAL,    // received -> shown
+        STAGE_COUNT
+    };
+    static const int COMMAND_TYPES = 8;  // CMD_LOAD_GIF .. CMD_DELETE_ELEMENT, 0 = unknown
+
+    void record(const CommandTrace& trace);
+    void clear();
+
+    const LatencyHistogram& histogram(uint8_t command, Stage stage) const;
+
+    // One line, total p50/p99 per command type seen, e.g.
+    // "total p50/p99 us: LOAD_GIF 41230/88100 DISPLAY_TEXT 5120/9800"
+    std::string summary() const;
+
+    // One line, all stages of one command type, e.g.
+    // "DISPLAY_TEXT n=12 serial 350/410 queue 20/45 apply 90/130 render 4800/9100 total 5200/9800"
+    std::string stageSummary(uint8_t command) const;
+
+    // Table of every command type and stage (count, p50, p99, max, mean)
+    void dump(std::ostream& out) const;
+
+    static const char* stageName(Stage stage);
+    static const char* commandName(uint8_t command);
+
+private:
+    static int typeIndex(uint8_t command) { return command < COMMAND_TYPES ? command : 0; }
+
+    LatencyHistogram histograms[COMMAND_TYPES][STAGE_COUNT];
+};
@@ -90,6 +90,30 @@ void StoreInStream(const Magick::Image &img, int delay_time_us,
   output->Stream(*scratch, delay_time_us);
 }
 
+size_t StoreInStream(const FrameStore &frames, size_t frame_index,
+                     int x_offset, int y_offset,
+                     rgb_matrix::FrameCanvas *scratch,
+                     rgb_matrix::StreamWriter *output) {
+  const PackedFrame &frame = frames.frame(frame_index);
+  scratch->Clear();
+  for (int y = 0; y < frames.height(); ++y) {
+    const uint8_t *src = frame.rgb + (size_t)y * frames.width() * 3;
+    const uint8_t *mask = frame.mask + (size_t)y * frames.maskStride();
+    for (int x = 0; x < frames.width(); ++x) {
+      if (mask[x >> 3] & (0x80 >> (x & 7))) {
+        scratch->SetPixel(x + x_offset, y + y_offset,
+                          src[x * 3], src[x * 3 + 1], src[x * 3 + 2]);
+      }
+    }
+  }
+  output->Stream(*scratch, frame.delay_us);
+
+  const char *data;
+  size_t len;
+  scratch->Serialize(&data, &len);
+  return len;
+}
+
 
 bool LoadImageAndScale(const char *filename,
                               int target_width, int target_height,
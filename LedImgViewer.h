@@ -2,6 +2,7 @@
 
 #include "led-matrix.h"
 #include "content-streamer.h"
+#include "FrameStore.h"
 #include <Magick++.h>
 #include <string>
 #include <vector>
@@ -40,4 +41,11 @@ bool LoadImageAndScale(const char *filename,
 void StoreInStream(const Magick::Image &img, int delay_time_us,
                   bool do_center,
                   rgb_matrix::FrameCanvas *scratch,
-                  rgb_matrix::StreamWriter *output);
\ No newline at end of file
+                  rgb_matrix::StreamWriter *output);
+
+// Same as above for an already decoded frame; the frame's own delay is used.
+// Returns the serialized size of the streamed canvas.
+size_t StoreInStream(const FrameStore &frames, size_t frame_index,
+                    int x_offset, int y_offset,
+                    rgb_matrix::FrameCanvas *scratch,
+                    rgb_matrix::StreamWriter *output);
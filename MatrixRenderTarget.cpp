@@ -0,0 +1,17 @@
+#include "MatrixRenderTarget.h"
+
+MatrixRenderTarget::MatrixRenderTarget(rgb_matrix::RGBMatrix* matrix)
+    : led_matrix(matrix), back_canvas(matrix->CreateFrameCanvas()) {
+}
+
+void MatrixRenderTarget::blitRow(int x, int y, const uint8_t* rgb, int count) {
+    // FrameCanvas has no row write; SetPixel applies brightness and the
+    // pixel mapper per pixel
+    for (int i = 0; i < count; i++, rgb += 3) {
+        back_canvas->SetPixel(x + i, y, rgb[0], rgb[1], rgb[2]);
+    }
+}
+
+void MatrixRenderTarget::swap() {
+    back_canvas = led_matrix->SwapOnVSync(back_canvas, 1);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "RenderTarget.h"
+#include "led-matrix.h"
+
+// RenderTarget on the LED panels: draws into a FrameCanvas and shows it
+// with SwapOnVSync. The matrix owns the canvases.
+class MatrixRenderTarget : public RenderTarget {
+public:
+    explicit MatrixRenderTarget(rgb_matrix::RGBMatrix* matrix);
+
+    int width() const override { return led_matrix->width(); }
+    int height() const override { return led_matrix->height(); }
+
+    void setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) override {
+        back_canvas->SetPixel(x, y, r, g, b);
+    }
+    void blitRow(int x, int y, const uint8_t* rgb, int count) override;
+    void clear() override { back_canvas->Clear(); }
+    void swap() override;
+
+    void setBrightness(uint8_t percent) override { led_matrix->SetBrightness(percent); }
+    uint8_t brightness() override { return led_matrix->brightness(); }
+
+    MatrixRenderTarget* asMatrix() override { return this; }
+
+    rgb_matrix::RGBMatrix* matrix() { return led_matrix; }
+    // Current back buffer (content stream playback writes into it directly)
+    rgb_matrix::FrameCanvas* canvas() { return back_canvas; }
+
+private:
+    rgb_matrix::RGBMatrix* led_matrix;
+    rgb_matrix::FrameCanvas* back_canvas;
+};
@@ -0,0 +1,106 @@
+#include "MemoryRenderTarget.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+MemoryRenderTarget::MemoryRenderTarget(int width, int height)
+    : buffer_width(width), buffer_height(height),
+      front((size_t)width * height * 3, 0), back((size_t)width * height * 3, 0),
+      current_brightness(100), swaps(0) {
+}
+
+void MemoryRenderTarget::setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+    if (x < 0 || y < 0 || x >= buffer_width || y >= buffer_height) return;
+
+    uint8_t* dst = &back[((size_t)y * buffer_width + x) * 3];
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+}
+
+void MemoryRenderTarget::blitRow(int x, int y, const uint8_t* rgb, int count) {
+    if (y < 0 || y >= buffer_height) return;
+
+    // Clip to the row
+    if (x < 0) {
+        rgb -= x * 3;
+        count += x;
+        x = 0;
+    }
+    count = std::min(count, buffer_width - x);
+    if (count <= 0) return;
+
+    memcpy(&back[((size_t)y * buffer_width + x) * 3], rgb, (size_t)count * 3);
+}
+
+void MemoryRenderTarget::clear() {
+    std::fill(back.begin(), back.end(), 0);
+}
+
+void MemoryRenderTarget::swap() {
+    front.swap(back);
+    swaps++;
+}
+
+uint64_t MemoryRenderTarget::frameHash() const {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < front.size(); i++) {
+        hash ^= front[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+FrameDumpRenderTarget::FrameDumpRenderTarget(int width, int height, const std::string& path,
+                                             Format format, int fps)
+    : MemoryRenderTarget(width, height), format(format) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open frame dump " << path << std::endl;
+        return;
+    }
+    if (format == Y4M) {
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+        planes.resize((size_t)width * height * 3);
+    }
+}
+
+FrameDumpRenderTarget::~FrameDumpRenderTarget() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+void FrameDumpRenderTarget::swap() {
+    MemoryRenderTarget::swap();
+    if (!file) return;
+
+    if (format == PPM) {
+        writePpm();
+    } else {
+        writeY4m();
+    }
+}
+
+void FrameDumpRenderTarget::writePpm() {
+    fprintf(file, "P6\n%d %d\n255\n", width(), height());
+    fwrite(frontPixels(), 3, (size_t)width() * height(), file);
+}
+
+void FrameDumpRenderTarget::writeY4m() {
+    // BT.601 limited range, no chroma subsampling
+    const size_t pixels = (size_t)width() * height();
+    const uint8_t* rgb = frontPixels();
+    uint8_t* y_plane = planes.data();
+    uint8_t* u_plane = y_plane + pixels;
+    uint8_t* v_plane = u_plane + pixels;
+    for (size_t i = 0; i < pixels; i++, rgb += 3) {
+        const int r = rgb[0], g = rgb[1], b = rgb[2];
+        y_plane[i] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u_plane[i] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v_plane[i] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    fputs("FRAME\n", file);
+    fwrite(planes.data(), 1, planes.size(), file);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "RenderTarget.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Headless RenderTarget: two RGB888 buffers swapped like FrameCanvas, so
+// the renderer's partial updates behave exactly as on the panels. For
+// timing and frame hashing off the Pi (any width x height, e.g. 192x192 or
+// 64x512). Brightness is recorded, not applied to the pixels.
+class MemoryRenderTarget : public RenderTarget {
+public:
+    MemoryRenderTarget(int width, int height);
+
+    int width() const override { return buffer_width; }
+    int height() const override { return buffer_height; }
+
+    void setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) override;
+    void blitRow(int x, int y, const uint8_t* rgb, int count) override;
+    void clear() override;
+    void swap() override;
+
+    void setBrightness(uint8_t percent) override { current_brightness = percent; }
+    uint8_t brightness() override { return current_brightness; }
+
+    // Shown frame, width * height * 3 bytes, row-major
+    const uint8_t* frontPixels() const { return front.data(); }
+    // FNV-1a hash of the shown frame
+    uint64_t frameHash() const;
+    // Number of swap() calls
+    uint64_t swapCount() const { return swaps; }
+
+private:
+    int buffer_width;
+    int buffer_height;
+    std::vector<uint8_t> front;
+    std::vector<uint8_t> back;
+    uint8_t current_brightness;
+    uint64_t swaps;
+};
+
+// MemoryRenderTarget that also appends every shown frame to a file:
+// PPM (concatenated P6 images, e.g. ffmpeg -f image2pipe -c:v ppm -i out.ppm)
+// or Y4M (YUV 4:4:4 video, playable with ffplay / mpv).
+class FrameDumpRenderTarget : public MemoryRenderTarget {
+public:
+    enum Format { PPM, Y4M };
+
+    // fps only goes into the Y4M header
+    FrameDumpRenderTarget(int width, int height, const std::string& path, Format format, int fps = 60);
+    ~FrameDumpRenderTarget();
+
+    bool isOpen() const { return file != nullptr; }
+
+    void swap() override;
+
+private:
+    void writePpm();
+    void writeY4m();
+
+    FILE* file;
+    Format format;
+    std::vector<uint8_t> planes;  // Y4M Y, U and V planes
+};
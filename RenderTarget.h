@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+class MatrixRenderTarget;
+
+// Where DisplayManager puts its frames. Double-buffered like the matrix
+// FrameCanvas: drawing goes to the back buffer and swap() shows it; the new
+// back buffer then holds the frame shown before (two frames old by the time
+// it is drawn into). Pixels outside width() x height() are ignored.
+//
+// MatrixRenderTarget drives the LED panels; MemoryRenderTarget and
+// FrameDumpRenderTarget run the same render path headless.
+class RenderTarget {
+public:
+    virtual ~RenderTarget() {}
+
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+
+    virtual void setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) = 0;
+    // Write count RGB888 pixels (R G B) starting at (x, y)
+    virtual void blitRow(int x, int y, const uint8_t* rgb, int count) = 0;
+    // Clear the back buffer to black
+    virtual void clear() = 0;
+    // Show the back buffer
+    virtual void swap() = 0;
+
+    // Panel brightness in percent
+    virtual void setBrightness(uint8_t percent) = 0;
+    virtual uint8_t brightness() = 0;
+
+    // The matrix backend, for paths that need rgb_matrix itself (content
+    // streams); nullptr for headless targets
+    virtual MatrixRenderTarget* asMatrix() { return nullptr; }
+};
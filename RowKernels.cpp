@@ -0,0 +1,289 @@
+#include "RowKernels.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ROW_KERNELS_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Scalar reference
+
+static inline bool maskBit(const uint8_t* mask, int x) {
+    return (mask[x >> 3] & (0x80 >> (x & 7))) != 0;
+}
+
+static inline void copyPixel(uint8_t* dst, const uint8_t* src) {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+}
+
+static void maskedCopyScalar(uint8_t* dst, const uint8_t* src, const uint8_t* mask,
+                             int first, int count) {
+    const int end = first + count;
+    for (int x = first; x < end; ++x) {
+        uint8_t bits = mask[x >> 3];
+        if (bits == 0) {
+            x |= 7; // Transparent up to the end of the mask byte
+            continue;
+        }
+        if (bits & (0x80 >> (x & 7))) {
+            copyPixel(dst + x * 3, src + x * 3);
+        }
+    }
+}
+
+static void colorKeyCopyScalar(uint8_t* dst, const uint8_t* src, int count, uint32_t key) {
+    const uint8_t key_r = key & 0xFF;
+    const uint8_t key_g = (key >> 8) & 0xFF;
+    const uint8_t key_b = (key >> 16) & 0xFF;
+    for (int i = 0; i < count; ++i, dst += 3, src += 3) {
+        if (src[0] != key_r || src[1] != key_g || src[2] != key_b) {
+            copyPixel(dst, src);
+        }
+    }
+}
+
+static void expandPaletteScalar(uint8_t* dst, const uint8_t* indices, int count,
+                                const uint32_t* palette) {
+    for (int i = 0; i < count; ++i, dst += 3) {
+        uint32_t color = palette[indices[i]];
+        dst[0] = color & 0xFF;
+        dst[1] = (color >> 8) & 0xFF;
+        dst[2] = (color >> 16) & 0xFF;
+    }
+}
+
+static const RowKernels SCALAR_KERNELS = {
+    "scalar", maskedCopyScalar, colorKeyCopyScalar, expandPaletteScalar
+};
+
+// ---------------------------------------------------------------------------
+// x86: SSE2 (baseline on x86-64) and AVX2 (compiled per function, used only
+// when the CPU reports it)
+
+#ifdef ROW_KERNELS_X86
+
+// Byte mask for 8 pixels (24 bytes used, padded to 32) for each mask byte
+struct MaskByteTable {
+    alignas(16) uint8_t bytes[256][32];
+    MaskByteTable() {
+        memset(bytes, 0, sizeof(bytes));
+        for (int bits = 0; bits < 256; bits++) {
+            for (int p = 0; p < 8; p++) {
+                if (bits & (0x80 >> p)) {
+                    memset(&bytes[bits][p * 3], 0xFF, 3);
+                }
+            }
+        }
+    }
+};
+static const MaskByteTable MASK_BYTES;
+
+static void maskedCopySse2(uint8_t* dst, const uint8_t* src, const uint8_t* mask,
+                           int first, int count) {
+    const int end = first + count;
+    int x = first;
+    for (; x < end && (x & 7); ++x) {
+        if (maskBit(mask, x)) copyPixel(dst + x * 3, src + x * 3);
+    }
+
+    // 8 pixels (one mask byte, 24 bytes) per step: 16 + 8 byte halves
+    for (; x + 8 <= end; x += 8) {
+        const uint8_t bits = mask[x >> 3];
+        if (bits == 0) continue;
+        uint8_t* d = dst + x * 3;
+        const uint8_t* s = src + x * 3;
+        if (bits == 0xFF) {
+            memcpy(d, s, 24);
+            continue;
+        }
+        const uint8_t* m = MASK_BYTES.bytes[bits];
+        __m128i m0 = _mm_load_si128((const __m128i*)m);
+        __m128i m1 = _mm_loadl_epi64((const __m128i*)(m + 16));
+        __m128i d0 = _mm_loadu_si128((const __m128i*)d);
+        __m128i d1 = _mm_loadl_epi64((const __m128i*)(d + 16));
+        __m128i s0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i s1 = _mm_loadl_epi64((const __m128i*)(s + 16));
+        d0 = _mm_or_si128(_mm_and_si128(m0, s0), _mm_andnot_si128(m0, d0));
+        d1 = _mm_or_si128(_mm_and_si128(m1, s1), _mm_andnot_si128(m1, d1));
+        _mm_storeu_si128((__m128i*)d, d0);
+        _mm_storel_epi64((__m128i*)(d + 16), d1);
+    }
+
+    for (; x < end; ++x) {
+        if (maskBit(mask, x)) copyPixel(dst + x * 3, src + x * 3);
+    }
+}
+
+// Key pattern (R G B repeated) for bytes 0..47 of a 16 pixel block
+struct KeyPattern {
+    alignas(16) uint8_t bytes[48];
+    explicit KeyPattern(uint32_t key) {
+        for (int i = 0; i < 48; i++) {
+            bytes[i] = (key >> ((i % 3) * 8)) & 0xFF;
+        }
+    }
+};
+
+// Bit 3*p set for pixel p of a 16 pixel block
+static const uint64_t PIXEL_START_BITS = 0x249249249249ULL;
+
+static void colorKeyCopySse2(uint8_t* dst, const uint8_t* src, int count, uint32_t key) {
+    const KeyPattern pattern(key);
+    const __m128i k0 = _mm_load_si128((const __m128i*)pattern.bytes);
+    const __m128i k1 = _mm_load_si128((const __m128i*)(pattern.bytes + 16));
+    const __m128i k2 = _mm_load_si128((const __m128i*)(pattern.bytes + 32));
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8_t* s = src + i * 3;
+        uint8_t* d = dst + i * 3;
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)s), k0);
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + 16)), k1);
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + 32)), k2);
+        uint64_t equal = (uint64_t)(uint16_t)_mm_movemask_epi8(e0) |
+                         (uint64_t)(uint16_t)_mm_movemask_epi8(e1) << 16 |
+                         (uint64_t)(uint16_t)_mm_movemask_epi8(e2) << 32;
+        // A pixel is the key colour when all three of its bytes match
+        uint64_t keyed = equal & (equal >> 1) & (equal >> 2) & PIXEL_START_BITS;
+        if (keyed == PIXEL_START_BITS) continue;
+        if (keyed == 0) {
+            memcpy(d, s, 48);
+            continue;
+        }
+        for (int p = 0; p < 16; p++) {
+            if (!(keyed & (1ULL << (p * 3)))) copyPixel(d + p * 3, s + p * 3);
+        }
+    }
+    colorKeyCopyScalar(dst + i * 3, src + i * 3, count - i, key);
+}
+
+static const RowKernels SSE2_KERNELS = {
+    "sse2", maskedCopySse2, colorKeyCopySse2, expandPaletteScalar
+};
+
+// Per byte of a 48 byte / 16 pixel block: which of the two mask bytes holds
+// the pixel's bit, and the bit itself
+alignas(32) static const uint8_t AVX2_SELECT_LO[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1
+};
+alignas(32) static const uint8_t AVX2_BIT_LO[32] = {
+    0x80, 0x80, 0x80, 0x40, 0x40, 0x40, 0x20, 0x20, 0x20, 0x10, 0x10, 0x10, 0x08, 0x08, 0x08, 0x04,
+    0x04, 0x04, 0x02, 0x02, 0x02, 0x01, 0x01, 0x01, 0x80, 0x80, 0x80, 0x40, 0x40, 0x40, 0x20, 0x20
+};
+alignas(16) static const uint8_t AVX2_SELECT_HI[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+alignas(16) static const uint8_t AVX2_BIT_HI[16] = {
+    0x20, 0x10, 0x10, 0x10, 0x08, 0x08, 0x08, 0x04, 0x04, 0x04, 0x02, 0x02, 0x02, 0x01, 0x01, 0x01
+};
+
+__attribute__((target("avx2")))
+static void maskedCopyAvx2(uint8_t* dst, const uint8_t* src, const uint8_t* mask,
+                           int first, int count) {
+    const int end = first + count;
+    int x = first;
+    for (; x < end && (x & 7); ++x) {
+        if (maskBit(mask, x)) copyPixel(dst + x * 3, src + x * 3);
+    }
+
+    const __m256i select_lo = _mm256_load_si256((const __m256i*)AVX2_SELECT_LO);
+    const __m256i bit_lo = _mm256_load_si256((const __m256i*)AVX2_BIT_LO);
+    const __m128i select_hi = _mm_load_si128((const __m128i*)AVX2_SELECT_HI);
+    const __m128i bit_hi = _mm_load_si128((const __m128i*)AVX2_BIT_HI);
+
+    // 16 pixels (two mask bytes, 48 bytes) per step: 32 + 16 byte parts.
+    // The mask bytes are spread to every byte of their pixel with a shuffle
+    // and turned into a byte mask with a bit test.
+    for (; x + 16 <= end; x += 16) {
+        const uint16_t bits = mask[x >> 3] | mask[(x >> 3) + 1] << 8;
+        if (bits == 0) continue;
+        uint8_t* d = dst + x * 3;
+        const uint8_t* s = src + x * 3;
+        if (bits == 0xFFFF) {
+            memcpy(d, s, 48);
+            continue;
+        }
+        const __m256i spread = _mm256_set1_epi16((short)bits);
+        __m256i m_lo = _mm256_shuffle_epi8(spread, select_lo);
+        m_lo = _mm256_cmpeq_epi8(_mm256_and_si256(m_lo, bit_lo), bit_lo);
+        __m128i m_hi = _mm_shuffle_epi8(_mm256_castsi256_si128(spread), select_hi);
+        m_hi = _mm_cmpeq_epi8(_mm_and_si128(m_hi, bit_hi), bit_hi);
+
+        __m256i d_lo = _mm256_loadu_si256((const __m256i*)d);
+        __m128i d_hi = _mm_loadu_si128((const __m128i*)(d + 32));
+        d_lo = _mm256_blendv_epi8(d_lo, _mm256_loadu_si256((const __m256i*)s), m_lo);
+        d_hi = _mm_blendv_epi8(d_hi, _mm_loadu_si128((const __m128i*)(s + 32)), m_hi);
+        _mm256_storeu_si256((__m256i*)d, d_lo);
+        _mm_storeu_si128((__m128i*)(d + 32), d_hi);
+    }
+
+    for (; x < end; ++x) {
+        if (maskBit(mask, x)) copyPixel(dst + x * 3, src + x * 3);
+    }
+}
+
+// Drop the 4th byte of each RGBX entry: 4 pixels -> 12 bytes per 128-bit lane
+alignas(32) static const int8_t AVX2_PACK_RGB[32] = {
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+};
+
+__attribute__((target("avx2")))
+static void expandPaletteAvx2(uint8_t* dst, const uint8_t* indices, int count,
+                              const uint32_t* palette) {
+    const __m256i pack = _mm256_load_si256((const __m256i*)AVX2_PACK_RGB);
+
+    // 8 pixels per step; each lane is stored as 16 bytes of which 12 are
+    // used, so keep 2 pixels of slack for the overhanging 4 bytes
+    int i = 0;
+    for (; i + 10 <= count; i += 8) {
+        __m128i idx8 = _mm_loadl_epi64((const __m128i*)(indices + i));
+        __m256i idx = _mm256_cvtepu8_epi32(idx8);
+        __m256i rgbx = _mm256_i32gather_epi32((const int*)palette, idx, 4);
+        __m256i rgb = _mm256_shuffle_epi8(rgbx, pack);
+        _mm_storeu_si128((__m128i*)(dst + i * 3), _mm256_castsi256_si128(rgb));
+        _mm_storeu_si128((__m128i*)(dst + i * 3 + 12), _mm256_extracti128_si256(rgb, 1));
+    }
+    expandPaletteScalar(dst + i * 3, indices + i, count - i, palette);
+}
+
+// AVX2 has no better colour-key test than the SSE2 movemask one
+static const RowKernels AVX2_KERNELS = {
+    "avx2", maskedCopyAvx2, colorKeyCopySse2, expandPaletteAvx2
+};
+
+#endif // ROW_KERNELS_X86
+
+// ARM NEON variant, built in RowKernelsNeon.cpp (the only file compiled with
+// NEON enabled on 32-bit ARM). nullptr if built without NEON or the CPU has none.
+const RowKernels* neonRowKernels();
+
+
+// ---------------------------------------------------------------------------
+
+std::vector<const RowKernels*> availableRowKernels() {
+    std::vector<const RowKernels*> kernels;
+    kernels.push_back(&SCALAR_KERNELS);
+#ifdef ROW_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) kernels.push_back(&SSE2_KERNELS);
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(&AVX2_KERNELS);
+#endif
+    if (neonRowKernels()) kernels.push_back(neonRowKernels());
+    return kernels;
+}
+
+const RowKernels& scalarRowKernels() {
+    return SCALAR_KERNELS;
+}
+
+const RowKernels& rowKernels() {
+    // The last available variant is the widest
+    static const RowKernels& selected = *availableRowKernels().back();
+    return selected;
+}
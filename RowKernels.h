@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Row kernels used by the compositor, RGB888 pixels (3 bytes, R G B).
+// Each CPU variant (scalar, SSE2, AVX2, NEON) produces byte-identical
+// output; the fastest one the CPU supports is picked on first use.
+struct RowKernels {
+    const char* name;
+
+    // Copy src to dst where the mask bit is set, for pixels first ..
+    // first+count-1. mask has one bit per pixel, MSB first (the PackedFrame /
+    // BDF layout); dst, src and mask all point at pixel 0 of the row.
+    void (*masked_copy)(uint8_t* dst, const uint8_t* src, const uint8_t* mask,
+                        int first, int count);
+
+    // Copy count pixels from src to dst, except those equal to the key
+    // colour (key = r | g << 8 | b << 16).
+    void (*color_key_copy)(uint8_t* dst, const uint8_t* src, int count, uint32_t key);
+
+    // Write palette[indices[i]] as RGB for count pixels. Palette entries are
+    // packed r | g << 8 | b << 16 (see ColorPalette::packed).
+    void (*expand_palette)(uint8_t* dst, const uint8_t* indices, int count,
+                           const uint32_t* palette);
+};
+
+// Kernels selected for this CPU
+const RowKernels& rowKernels();
+
+// Plain C++ reference implementation
+const RowKernels& scalarRowKernels();
+
+// Every variant this CPU can run, scalar first (for tests and benchmarks)
+std::vector<const RowKernels*> availableRowKernels();
+
+inline void blitMaskedRow(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int first, int count) {
+    rowKernels().masked_copy(dst, src, mask, first, count);
+}
@@ -0,0 +1,109 @@
+// NEON row kernels. Kept in their own file: on 32-bit ARM only this file is
+// compiled with NEON enabled, so nothing else picks up NEON instructions and
+// the binary still runs (with the other kernels) on CPUs without it.
+#include "RowKernels.h"
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static inline bool maskBit(const uint8_t* mask, int x) {
+    return (mask[x >> 3] & (0x80 >> (x & 7))) != 0;
+}
+
+static inline void copyPixel(uint8_t* dst, const uint8_t* src) {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+}
+
+// vld3/vst3 split and rejoin the R, G and B planes, so each step works on
+// 16 whole pixels
+
+static void maskedCopyNeon(uint8_t* dst, const uint8_t* src, const uint8_t* mask,
+                           int first, int count) {
+    static const uint8_t bit_values[16] = {
+        0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+        0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+    };
+    const uint8x16_t bit = vld1q_u8(bit_values);
+
+    const int end = first + count;
+    int x = first;
+    for (; x < end && (x & 7); ++x) {
+        if (maskBit(mask, x)) copyPixel(dst + x * 3, src + x * 3);
+    }
+
+    for (; x + 16 <= end; x += 16) {
+        const uint8_t lo = mask[x >> 3];
+        const uint8_t hi = mask[(x >> 3) + 1];
+        if ((lo | hi) == 0) continue;
+        uint8_t* d = dst + x * 3;
+        const uint8_t* s = src + x * 3;
+        if ((lo & hi) == 0xFF) {
+            memcpy(d, s, 48);
+            continue;
+        }
+        uint8x16_t m = vtstq_u8(vcombine_u8(vdup_n_u8(lo), vdup_n_u8(hi)), bit);
+        uint8x16x3_t sp = vld3q_u8(s);
+        uint8x16x3_t dp = vld3q_u8(d);
+        dp.val[0] = vbslq_u8(m, sp.val[0], dp.val[0]);
+        dp.val[1] = vbslq_u8(m, sp.val[1], dp.val[1]);
+        dp.val[2] = vbslq_u8(m, sp.val[2], dp.val[2]);
+        vst3q_u8(d, dp);
+    }
+
+    for (; x < end; ++x) {
+        if (maskBit(mask, x)) copyPixel(dst + x * 3, src + x * 3);
+    }
+}
+
+static void colorKeyCopyNeon(uint8_t* dst, const uint8_t* src, int count, uint32_t key) {
+    const uint8x16_t key_r = vdupq_n_u8(key & 0xFF);
+    const uint8x16_t key_g = vdupq_n_u8((key >> 8) & 0xFF);
+    const uint8x16_t key_b = vdupq_n_u8((key >> 16) & 0xFF);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t sp = vld3q_u8(src + i * 3);
+        uint8x16x3_t dp = vld3q_u8(dst + i * 3);
+        uint8x16_t keyed = vandq_u8(vandq_u8(vceqq_u8(sp.val[0], key_r),
+                                             vceqq_u8(sp.val[1], key_g)),
+                                    vceqq_u8(sp.val[2], key_b));
+        dp.val[0] = vbslq_u8(keyed, dp.val[0], sp.val[0]);
+        dp.val[1] = vbslq_u8(keyed, dp.val[1], sp.val[1]);
+        dp.val[2] = vbslq_u8(keyed, dp.val[2], sp.val[2]);
+        vst3q_u8(dst + i * 3, dp);
+    }
+    scalarRowKernels().color_key_copy(dst + i * 3, src + i * 3, count - i, key);
+}
+
+static void expandPaletteNeon(uint8_t* dst, const uint8_t* indices, int count,
+                              const uint32_t* palette) {
+    // NEON table lookups reach 32 (ARMv7) or 64 (AArch64) entries, not 256
+    scalarRowKernels().expand_palette(dst, indices, count, palette);
+}
+
+static const RowKernels NEON_KERNELS = {
+    "neon", maskedCopyNeon, colorKeyCopyNeon, expandPaletteNeon
+};
+
+const RowKernels* neonRowKernels() {
+#if defined(__aarch64__)
+    return &NEON_KERNELS; // Mandatory on AArch64
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) ? &NEON_KERNELS : nullptr;
+#endif
+}
+
+#else
+
+const RowKernels* neonRowKernels() {
+    return nullptr;
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include "ColorPalette.h"
 
 struct ScreenConfig {
     // Screen identification
@@ -23,10 +24,20 @@ struct ScreenConfig {
     // Serial configuration
     std::string serial_port;
     int serial_baudrate;
+    std::string serial_capture;  // Record received bytes here (empty = off), see liv-replay
     
     // Display options
     bool show_diagnostics;
     
+    // Memory budget for decoded GIF frames shared between elements (MB)
+    int asset_cache_mb;
+    
+    // Directory for pre-scaled frame files (empty = no disk cache)
+    std::string frame_cache_dir;
+    
+    // Colour pipeline: 256-colour palette or 24-bit RGB
+    ColorMode color_mode;
+    
     // Default constructor with default values for 192x192 screen (ID=1)
     ScreenConfig() 
         : screen_id(1)
@@ -39,7 +50,11 @@ struct ScreenConfig {
         , gpio_slowdown(3)
         , serial_port("/dev/ttyUSB0")
         , serial_baudrate(1000000)
+        , serial_capture("")
         , show_diagnostics(true)
+        , asset_cache_mb(64)
+        , frame_cache_dir("cache")
+        , color_mode(COLOR_MODE_PALETTE256)
     {}
     
     // Load configuration from INI file
@@ -95,8 +110,19 @@ struct ScreenConfig {
                     serial_port = value;
                 } else if (key == "serial_baudrate") {
                     serial_baudrate = std::stoi(value);
+                } else if (key == "serial_capture") {
+                    serial_capture = value;
                 } else if (key == "show_diagnostics") {
                     show_diagnostics = (value == "true" || value == "1" || value == "yes");
+                } else if (key == "asset_cache_mb") {
+                    asset_cache_mb = std::stoi(value);
+                } else if (key == "frame_cache_dir") {
+                    frame_cache_dir = value;
+                } else if (key == "color_mode") {
+                    if (!parseColorMode(value, &color_mode)) {
+                        std::cerr << "Unknown color_mode '" << value << "', using "
+                                  << colorModeName(color_mode) << std::endl;
+                    }
                 }
             }
         }
@@ -117,7 +143,11 @@ struct ScreenConfig {
         std::cout << "Pixel mapper: " << (pixel_mapper.empty() ? "(none)" : pixel_mapper) << std::endl;
         std::cout << "GPIO slowdown: " << gpio_slowdown << std::endl;
         std::cout << "Serial port: " << serial_port << " @ " << serial_baudrate << " baud" << std::endl;
+        std::cout << "Serial capture: " << (serial_capture.empty() ? "(off)" : serial_capture) << std::endl;
         std::cout << "Show diagnostics: " << (show_diagnostics ? "yes" : "no") << std::endl;
+        std::cout << "Asset cache: " << asset_cache_mb << " MB" << std::endl;
+        std::cout << "Frame cache dir: " << (frame_cache_dir.empty() ? "(disabled)" : frame_cache_dir) << std::endl;
+        std::cout << "Color mode: " << colorModeName(color_mode) << std::endl;
         std::cout << "============================" << std::endl;
     }
     
@@ -0,0 +1,138 @@
+#include "SerialCapture.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Capture file layout (host byte order; the Pi and x86 desk machines are
+// both little-endian):
+//   SerialCaptureHeader
+//   records: SerialCaptureRecord, then length bytes as read from the port
+// delta_us is the time since the previous record (the first record's since
+// start_time_us), so a capture costs 6 bytes per read() on top of the data.
+struct SerialCaptureHeader {
+    char magic[6];           // "LIVCAP"
+    uint16_t version;
+    uint64_t start_time_us;  // CLOCK_MONOTONIC when recording started
+} __attribute__((packed));
+
+struct SerialCaptureRecord {
+    uint32_t delta_us;
+    uint16_t length;
+} __attribute__((packed));
+
+static const char SERIAL_CAPTURE_MAGIC[6] = {'L', 'I', 'V', 'C', 'A', 'P'};
+static const uint16_t SERIAL_CAPTURE_VERSION = 1;
+
+SerialCaptureWriter::SerialCaptureWriter() : fd(-1), last_time_us(0) {
+}
+
+SerialCaptureWriter::~SerialCaptureWriter() {
+    close();
+}
+
+bool SerialCaptureWriter::open(const std::string& path, uint64_t start_time_us) {
+    close();
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot create serial capture " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    SerialCaptureHeader header;
+    memcpy(header.magic, SERIAL_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = SERIAL_CAPTURE_VERSION;
+    header.start_time_us = start_time_us;
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        std::cerr << "Cannot write serial capture " << path << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    last_time_us = start_time_us;
+    std::cout << "Recording serial input to " << path << std::endl;
+    return true;
+}
+
+void SerialCaptureWriter::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void SerialCaptureWriter::record(uint64_t time_us, const uint8_t* data, size_t length) {
+    if (fd < 0) return;
+
+    while (length > 0) {
+        const uint16_t chunk = (uint16_t)std::min<size_t>(length, UINT16_MAX);
+
+        SerialCaptureRecord record;
+        const uint64_t delta = time_us > last_time_us ? time_us - last_time_us : 0;
+        record.delta_us = (uint32_t)std::min<uint64_t>(delta, UINT32_MAX);
+        record.length = chunk;
+        last_time_us = time_us;
+
+        // Header and bytes in one write, so records are never torn
+        buffer.resize(sizeof(record) + chunk);
+        memcpy(buffer.data(), &record, sizeof(record));
+        memcpy(buffer.data() + sizeof(record), data, chunk);
+        if (write(fd, buffer.data(), buffer.size()) != (ssize_t)buffer.size()) {
+            std::cerr << "Serial capture write failed: " << strerror(errno) << ", recording stopped" << std::endl;
+            close();
+            return;
+        }
+
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+SerialCaptureReader::SerialCaptureReader() : file(nullptr), elapsed_us(0) {
+}
+
+SerialCaptureReader::~SerialCaptureReader() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool SerialCaptureReader::open(const std::string& path, std::string* err_msg) {
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+        *err_msg = strerror(errno);
+        return false;
+    }
+
+    SerialCaptureHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, SERIAL_CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+        *err_msg = "not a serial capture";
+        return false;
+    }
+    if (header.version != SERIAL_CAPTURE_VERSION) {
+        *err_msg = "unsupported capture version " + std::to_string(header.version);
+        return false;
+    }
+
+    elapsed_us = 0;
+    return true;
+}
+
+bool SerialCaptureReader::next(uint64_t* time_us, std::vector<uint8_t>* data) {
+    if (!file) return false;
+
+    SerialCaptureRecord record;
+    if (fread(&record, sizeof(record), 1, file) != 1) return false;
+
+    data->resize(record.length);
+    if (record.length > 0 && fread(data->data(), record.length, 1, file) != 1) return false;
+
+    elapsed_us += record.delta_us;
+    *time_us = elapsed_us;
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Capture of the bytes received on the serial port, for replaying real
+// ESP32 sessions on a desk machine (liv-replay). One record per read() of
+// the port, with the monotonic time it returned; see SerialCapture.cpp for
+// the file layout.
+class SerialCaptureWriter {
+public:
+    SerialCaptureWriter();
+    ~SerialCaptureWriter();
+
+    bool open(const std::string& path, uint64_t start_time_us);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // Append the bytes of one read(). Written straight to the file, so a
+    // crash or a kill loses nothing that was already received.
+    void record(uint64_t time_us, const uint8_t* data, size_t length);
+
+private:
+    int fd;
+    uint64_t last_time_us;
+    std::vector<uint8_t> buffer;
+};
+
+class SerialCaptureReader {
+public:
+    SerialCaptureReader();
+    ~SerialCaptureReader();
+
+    bool open(const std::string& path, std::string* err_msg);
+
+    // Next record: its time since the start of the capture and its bytes.
+    // Returns false at the end of the capture (or at a truncated record).
+    bool next(uint64_t* time_us, std::vector<uint8_t>* data);
+
+private:
+    FILE* file;
+    uint64_t elapsed_us;
+};
@@ -5,10 +5,13 @@
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <time.h>
 #include <sys/ioctl.h>
 
 SerialProtocol::SerialProtocol() : serial_fd(-1), 
+    receive_time_us(0),
+    rx_offset(0),
     last_garbage_time_us(0),
     esp32_restart_detected_time_us(0),
     esp32_restart_grace_period(false) {
@@ -18,12 +21,14 @@ SerialProtocol::SerialProtocol() : serial_fd(-1),
 SerialProtocol::~SerialProtocol() {
     close();
     // Free any pending commands
-    for (auto cmd : pending_commands) {
-        free(cmd);
+    for (const auto& pending : pending_commands) {
+        free(pending.command);
     }
 }
 
 bool SerialProtocol::init(const char* device_path) {
+    this->device_path = device_path;
+    
     // Open serial port
     serial_fd = open(device_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
     if (serial_fd < 0) {
@@ -35,7 +40,7 @@ bool SerialProtocol::init(const char* device_path) {
     // Save current terminal settings
     if (tcgetattr(serial_fd, &old_tio) < 0) {
         std::cerr << "Failed to get serial port attributes" << std::endl;
-        close();
+        closePort();
         return false;
     }
     
@@ -61,7 +66,7 @@ bool SerialProtocol::init(const char* device_path) {
     tcflush(serial_fd, TCIFLUSH);
     if (tcsetattr(serial_fd, TCSANOW, &tio) < 0) {
         std::cerr << "Failed to set serial port attributes" << std::endl;
-        close();
+        closePort();
         return false;
     }
     
@@ -70,45 +75,53 @@ bool SerialProtocol::init(const char* device_path) {
 }
 
 void SerialProtocol::processData() {
+    // Read data from serial port
+    uint8_t buffer[1024];
+    ssize_t bytes_read = read(serial_fd, buffer, sizeof(buffer));
+    uint64_t current_time = getCurrentTimeUs();
+    
+    if (bytes_read > 0) {
+        capture.record(current_time, buffer, bytes_read);
+    }
+    processBytes(buffer, bytes_read > 0 ? bytes_read : 0, current_time);
+}
+
+void SerialProtocol::processBytes(const uint8_t* data, size_t length, uint64_t time_us) {
+    receive_time_us = time_us;
+    
     // Check if we're in ESP32 restart grace period
     if (esp32_restart_grace_period) {
-        uint64_t current_time = getCurrentTimeUs();
-        uint64_t elapsed = current_time - esp32_restart_detected_time_us;
+        uint64_t elapsed = time_us - esp32_restart_detected_time_us;
         
         if (elapsed < RESTART_GRACE_PERIOD_US) {
             // Still in grace period - just flush and ignore data
-            uint8_t dummy[1024];
-            ssize_t bytes_read = read(serial_fd, dummy, sizeof(dummy));
-            if (bytes_read > 0) {
-                std::cout << "ESP32 restart grace period: ignoring " << bytes_read 
+            if (length > 0) {
+                std::cout << "ESP32 restart grace period: ignoring " << length 
                           << " bytes (remaining: " << (RESTART_GRACE_PERIOD_US - elapsed) / 1000 << " ms)" << std::endl;
             }
-            rx_buffer.clear();
+            dropFromBuffer(rx_buffer.size());
             return;
         } else {
             // Grace period ended
             std::cout << "ESP32 restart grace period ended - resuming normal operation" << std::endl;
             esp32_restart_grace_period = false;
-            rx_buffer.clear();
+            dropFromBuffer(rx_buffer.size());
         }
     }
     
-    // Read data from serial port
-    uint8_t buffer[1024];
-    ssize_t bytes_read = read(serial_fd, buffer, sizeof(buffer));
-    
-    if (bytes_read > 0) {
-        std::cout << "=== Received " << bytes_read << " bytes from serial port ===" << std::endl;
+    if (length > 0) {
+        std::cout << "=== Received " << length << " bytes from serial port ===" << std::endl;
+        rx_chunks.push_back(RxChunk{rx_offset + rx_buffer.size(), time_us});
         
         // Add all received bytes to buffer
-        for (ssize_t i = 0; i < bytes_read; i++) {
-            if (buffer[i] == PROTOCOL_SOF) {
+        for (size_t i = 0; i < length; i++) {
+            if (data[i] == PROTOCOL_SOF) {
                 std::cout << "*** SOF received (0xAA) at buffer position " << rx_buffer.size() << std::endl;
             }
-            if (buffer[i] != 0 || rx_buffer.empty()) {
-                std::cout << "RX[" << rx_buffer.size() << "]: 0x" << std::hex << (int)buffer[i] << std::dec << std::endl;
+            if (data[i] != 0 || rx_buffer.empty()) {
+                std::cout << "RX[" << rx_buffer.size() << "]: 0x" << std::hex << (int)data[i] << std::dec << std::endl;
             }
-            addToBuffer(buffer[i]);
+            addToBuffer(data[i]);
         }
     }
     
@@ -118,7 +131,18 @@ void SerialProtocol::processData() {
     }
 }
 
-void SerialProtocol::sendResponse(uint8_t screen_id, ResponseCode code, const uint8_t* data, uint8_t data_len) {
+bool SerialProtocol::startCapture(const std::string& path) {
+    return capture.open(path, getCurrentTimeUs());
+}
+
+void SerialProtocol::sendResponse(uint8_t screen_id, ResponseCode code, const uint8_t* data, size_t data_len) {
+    // The whole response (header + data) has to fit the one-byte payload_length
+    if (data_len > PROTOCOL_MAX_RESPONSE_DATA) {
+        std::cerr << "Response data truncated from " << data_len << " to "
+                  << PROTOCOL_MAX_RESPONSE_DATA << " bytes" << std::endl;
+        data_len = PROTOCOL_MAX_RESPONSE_DATA;
+    }
+    
     Response response;
     response.screen_id = screen_id;
     response.command = CMD_RESPONSE;
@@ -152,8 +176,13 @@ void SerialProtocol::sendResponse(uint8_t screen_id, ResponseCode code, const ui
     // Copy packet after preamble
     memcpy(send_buffer + 3, &packet, sizeof(ProtocolPacket));
     
-    // Send via serial port
-    ssize_t sent = write(serial_fd, send_buffer, 3 + sizeof(ProtocolPacket));
+    // Send via serial port - one write per packet so concurrent responses
+    // from different threads do not interleave on the wire
+    ssize_t sent;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        sent = write(serial_fd, send_buffer, 3 + sizeof(ProtocolPacket));
+    }
     
     std::cout << ">>> RESPONSE SENT via serial port: screen_id=" << (int)screen_id 
               << " code=" << (int)code 
@@ -164,14 +193,19 @@ bool SerialProtocol::hasPendingCommand() {
     return !pending_commands.empty();
 }
 
-void* SerialProtocol::getNextCommand() {
+void* SerialProtocol::getNextCommand(CommandTrace* trace) {
     if (pending_commands.empty()) {
         return nullptr;
     }
     
-    void* cmd = pending_commands.front();
+    PendingCommand pending = pending_commands.front();
     pending_commands.erase(pending_commands.begin());
-    return cmd;
+    if (trace) {
+        trace->command = getCommandType(pending.command);
+        trace->received_us = pending.received_us;
+        trace->validated_us = pending.validated_us;
+    }
+    return pending.command;
 }
 
 CommandType SerialProtocol::getCommandType(void* command) {
@@ -188,6 +222,11 @@ void SerialProtocol::freeCommand(void* command) {
 }
 
 void SerialProtocol::close() {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    closePort();
+}
+
+void SerialProtocol::closePort() {
     if (serial_fd != -1) {
         // Restore old terminal settings
         tcsetattr(serial_fd, TCSANOW, &old_tio);
@@ -196,6 +235,15 @@ void SerialProtocol::close() {
     }
 }
 
+bool SerialProtocol::reopen() {
+    // Under write_mutex, so a response sent from the render thread meanwhile
+    // goes to the old port, the new one, or fails on -1 - never a stale fd
+    std::lock_guard<std::mutex> lock(write_mutex);
+    closePort();
+    const std::string path = device_path;
+    return !path.empty() && init(path.c_str());
+}
+
 void SerialProtocol::sendTestData() {
     if (serial_fd == -1) {
         std::cout << "Serial port not open, cannot send test data" << std::endl;
@@ -249,7 +297,7 @@ bool SerialProtocol::validatePacket(const ProtocolPacket* packet) {
     return true;
 }
 
-void SerialProtocol::parsePacket(const ProtocolPacket* packet) {
+void SerialProtocol::parsePacket(const ProtocolPacket* packet, uint64_t received_us) {
     std::cout << "parsePacket: command=" << (int)packet->command << " payload_length=" << (int)packet->payload_length << std::endl;
     
     if (!validatePacket(packet)) {
@@ -298,7 +346,7 @@ void SerialProtocol::parsePacket(const ProtocolPacket* packet) {
     }
     
     if (command) {
-        pending_commands.push_back(command);
+        pending_commands.push_back(PendingCommand{command, received_us, getCurrentTimeUs()});
         sendResponse(packet->screen_id, RESP_OK);
     } else {
         sendResponse(packet->screen_id, RESP_INVALID_PARAMS);
@@ -312,10 +360,28 @@ void SerialProtocol::addToBuffer(uint8_t byte) {
     // With preamble, we need more space for synchronization
     if (rx_buffer.size() > 2048) {
         std::cout << "Buffer overflow! Removing 512 bytes" << std::endl;
-        rx_buffer.erase(rx_buffer.begin(), rx_buffer.begin() + 512);
+        dropFromBuffer(512);
+    }
+}
+
+void SerialProtocol::dropFromBuffer(size_t count) {
+    count = std::min(count, rx_buffer.size());
+    rx_buffer.erase(rx_buffer.begin(), rx_buffer.begin() + count);
+    rx_offset += count;
+    
+    // Forget reads whose bytes are all gone
+    while (rx_chunks.size() > 1 && rx_chunks[1].offset <= rx_offset) {
+        rx_chunks.pop_front();
+    }
+    if (rx_buffer.empty()) {
+        rx_chunks.clear();
     }
 }
 
+uint64_t SerialProtocol::bufferStartTimeUs() const {
+    return rx_chunks.empty() ? receive_time_us : rx_chunks.front().time_us;
+}
+
 
 void SerialProtocol::processBuffer() {
     // Aggressive garbage removal for better synchronization
@@ -342,7 +408,7 @@ void SerialProtocol::processBuffer() {
             // Keep last 3 bytes in case preamble is being received
             if (garbage_size > 3) {
                 std::cout << "No valid preamble+SOF in buffer, clearing " << (garbage_size - 3) << " bytes of garbage (keeping last 3)" << std::endl;
-                rx_buffer.erase(rx_buffer.begin(), rx_buffer.begin() + (garbage_size - 3));
+                dropFromBuffer(garbage_size - 3);
                 
                 // Detect potential ESP32 restart
                 if (garbage_size > 100) {
@@ -355,7 +421,7 @@ void SerialProtocol::processBuffer() {
         // Remove any garbage before preamble
         if (preamble_position > 0) {
             std::cout << "Removing " << preamble_position << " bytes of garbage before preamble" << std::endl;
-            rx_buffer.erase(rx_buffer.begin(), rx_buffer.begin() + preamble_position);
+            dropFromBuffer(preamble_position);
         }
         
         // Now preamble+SOF is at position 0-3
@@ -394,7 +460,7 @@ void SerialProtocol::processBuffer() {
             std::cout << "EOF mismatch: expected 0xAA, got 0x" << std::hex << (int)rx_buffer[eof_position] << std::dec 
                       << " - this preamble was false positive, removing first byte" << std::endl;
             // This preamble was false positive, remove first byte and continue searching
-            rx_buffer.erase(rx_buffer.begin());
+            dropFromBuffer(1);
             continue;
         }
         
@@ -415,10 +481,11 @@ void SerialProtocol::processBuffer() {
         packet.checksum = rx_buffer[eof_position - 1];
         packet.eof = rx_buffer[eof_position];
         
-        parsePacket(&packet);
+        // Timed from the first preamble byte
+        parsePacket(&packet, bufferStartTimeUs());
         
         // Remove processed packet from buffer (including preamble)
-        rx_buffer.erase(rx_buffer.begin(), rx_buffer.begin() + total_packet_size);
+        dropFromBuffer(total_packet_size);
         std::cout << "Packet processed and removed, buffer now has " << rx_buffer.size() << " bytes" << std::endl;
         
         // Continue processing if there's more data
@@ -588,14 +655,15 @@ void* SerialProtocol::parseBrightnessCommand(const uint8_t* payload, uint8_t len
 }
 
 void* SerialProtocol::parseStatusCommand(const uint8_t* payload, uint8_t length) {
-    if (length < sizeof(StatusCommand)) {
+    // The detail byte is optional - older ESP32 firmware sends 2 bytes
+    if (length < 2) {
         return nullptr;
     }
     
-    StatusCommand* cmd = (StatusCommand*)malloc(sizeof(StatusCommand));
+    StatusCommand* cmd = (StatusCommand*)calloc(1, sizeof(StatusCommand));
     if (!cmd) return nullptr;
     
-    memcpy(cmd, payload, sizeof(StatusCommand));
+    memcpy(cmd, payload, std::min<size_t>(length, sizeof(StatusCommand)));
     return cmd;
 }
 
@@ -609,7 +677,7 @@ void SerialProtocol::detectESP32Restart(size_t garbage_bytes) {
     // If we receive >200 bytes of garbage, it's likely ESP32 restarted
     // ESP32 boot messages can be 500-1000+ bytes
     if (garbage_bytes > 200) {
-        uint64_t current_time = getCurrentTimeUs();
+        uint64_t current_time = receive_time_us;
         
         // If we haven't seen garbage in a while, this is likely a restart
         if (last_garbage_time_us == 0 || (current_time - last_garbage_time_us) > 5000000) { // 5 seconds
@@ -620,7 +688,7 @@ void SerialProtocol::detectESP32Restart(size_t garbage_bytes) {
             esp32_restart_grace_period = true;
             
             // Clear buffer
-            rx_buffer.clear();
+            dropFromBuffer(rx_buffer.size());
         }
         
         last_garbage_time_us = current_time;
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "SerialCapture.h"
+#include "LatencyTrace.h"
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <deque>
 #include <termios.h>
+#include <mutex>
 
 // Protocol constants - Preamble for reliable synchronization (like Ethernet)
 #define PROTOCOL_PREAMBLE_1 0xAA  // Preamble byte 1
@@ -12,6 +16,7 @@
 #define PROTOCOL_SOF 0x55         // Start of Frame (after preamble)
 #define PROTOCOL_EOF 0xAA         // End of Frame
 #define PROTOCOL_MAX_PAYLOAD 256
+#define PROTOCOL_MAX_RESPONSE_DATA (255 - 4)  // payload_length is one byte, incl. the 4-byte response header
 #define PROTOCOL_MAX_FILENAME 64
 #define PROTOCOL_MAX_TEXT_LINES 10
 #define PROTOCOL_MAX_TEXT_LENGTH 32
@@ -82,8 +87,14 @@ typedef struct {
 typedef struct {
     uint8_t screen_id;
     uint8_t command;
+    uint8_t detail;        // STATUS_* (optional, 2-byte requests get STATUS_GENERAL)
 } __attribute__((packed)) StatusCommand;
 
+// GET_STATUS detail levels
+#define STATUS_GENERAL 0x00          // Screen, elements, brightness, asset cache
+#define STATUS_LATENCY 0x01          // Total command-to-photon p50/p99 per command type
+#define STATUS_LATENCY_STAGES 0x10   // | command type: per-stage p50/p99 of that type
+
 // Delete element command structure
 typedef struct {
     uint8_t screen_id;
@@ -112,6 +123,12 @@ typedef struct {
 } __attribute__((packed)) ProtocolPacket;
 
 class SerialProtocol {
+    struct PendingCommand {
+        void* command;
+        uint64_t received_us;
+        uint64_t validated_us;
+    };
+    
 public:
     SerialProtocol();
     ~SerialProtocol();
@@ -122,14 +139,25 @@ public:
     // Process incoming data
     void processData();
     
-    // Send response
-    void sendResponse(uint8_t screen_id, ResponseCode code, const uint8_t* data = nullptr, uint8_t data_len = 0);
+    // Parse bytes received at time_us (monotonic) - what processData() does
+    // with each read(), exposed for capture replay and benchmarks. Restart
+    // detection follows time_us, so a replay behaves as the live session did.
+    void processBytes(const uint8_t* data, size_t length, uint64_t time_us);
+    
+    // Record every byte read from the port, with its arrival time, to a
+    // capture file (see SerialCapture.h); call before the port is read
+    bool startCapture(const std::string& path);
+    
+    // Send response (safe to call from the serial and the render thread)
+    // Longer data is truncated to PROTOCOL_MAX_RESPONSE_DATA bytes
+    void sendResponse(uint8_t screen_id, ResponseCode code, const uint8_t* data = nullptr, size_t data_len = 0);
     
     // Check if there are pending commands
     bool hasPendingCommand();
     
-    // Get next command (caller must free the memory)
-    void* getNextCommand();
+    // Get next command (caller must free the memory); with trace set, also
+    // its receive and validation times
+    void* getNextCommand(CommandTrace* trace = nullptr);
     
     // Get command type
     CommandType getCommandType(void* command);
@@ -137,17 +165,38 @@ public:
     // Cleanup command memory
     void freeCommand(void* command);
     
-    // Close serial connection
+    // Close serial connection (safe while the render thread sends responses)
     void close();
     
+    // After a hang-up (USB unplugged): close the port and open the device
+    // init() was given again. False while it is still gone - call again later.
+    bool reopen();
+    
+    // Serial port file descriptor (-1 if not open), for poll()
+    int getFd() const { return serial_fd; }
+    
     // Test function to send test data
     void sendTestData();
 
 private:
     int serial_fd;
+    std::string device_path;  // From init(), for reopen()
     struct termios old_tio;
+    std::mutex write_mutex;  // Responses are written from more than one thread
     std::vector<uint8_t> rx_buffer;
-    std::vector<void*> pending_commands;
+    std::vector<PendingCommand> pending_commands;
+    SerialCaptureWriter capture;
+    uint64_t receive_time_us;  // Arrival time of the bytes being parsed
+    
+    // Arrival time of each read() still (partly) in rx_buffer, so a packet
+    // is timed from its first byte even when it spans several reads.
+    // Offsets count every byte ever buffered; rx_offset is rx_buffer[0]'s.
+    struct RxChunk {
+        uint64_t offset;
+        uint64_t time_us;
+    };
+    std::deque<RxChunk> rx_chunks;
+    uint64_t rx_offset;
     
     // ESP32 restart detection
     uint64_t last_garbage_time_us;
@@ -155,11 +204,15 @@ private:
     bool esp32_restart_grace_period;
     static constexpr uint64_t RESTART_GRACE_PERIOD_US = 2000000; // 2 seconds
     
+    void closePort();  // close() without taking write_mutex
+    
     // Protocol functions
     uint8_t calculateChecksum(const uint8_t* data, uint8_t length);
     bool validatePacket(const ProtocolPacket* packet);
-    void parsePacket(const ProtocolPacket* packet);
+    void parsePacket(const ProtocolPacket* packet, uint64_t received_us);
     void addToBuffer(uint8_t byte);
+    void dropFromBuffer(size_t count);  // Remove bytes from the front of rx_buffer
+    uint64_t bufferStartTimeUs() const;  // Arrival time of rx_buffer[0]
     void processBuffer();
     uint64_t getCurrentTimeUs();  // Get current time in microseconds
     void detectESP32Restart(size_t garbage_bytes);  // Detect ESP32 restart from garbage
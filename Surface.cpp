@@ -0,0 +1,63 @@
+#include "Surface.h"
+#include "RowKernels.h"
+#include <algorithm>
+#include <cstring>
+
+Rect Rect::intersect(const Rect& other) const {
+    int left = std::max(x, other.x);
+    int top = std::max(y, other.y);
+    int r = std::min(right(), other.right());
+    int b = std::min(bottom(), other.bottom());
+    if (r <= left || b <= top) return Rect();
+    return Rect(left, top, r - left, b - top);
+}
+
+Rect Rect::unite(const Rect& other) const {
+    if (empty()) return other;
+    if (other.empty()) return *this;
+    int left = std::min(x, other.x);
+    int top = std::min(y, other.y);
+    return Rect(left, top, std::max(right(), other.right()) - left,
+                std::max(bottom(), other.bottom()) - top);
+}
+
+void Surface::resize(int width, int height, bool with_mask) {
+    surface_width = width;
+    surface_height = height;
+    pixels.assign((size_t)width * height * 3, 0);
+    mask_stride = with_mask ? (width + 7) / 8 : 0;
+    mask.assign(mask_stride * height, 0);
+}
+
+void Surface::clear() {
+    std::fill(pixels.begin(), pixels.end(), 0);
+    std::fill(mask.begin(), mask.end(), 0);
+}
+
+void Surface::clear(const Rect& rect) {
+    Rect area = rect.intersect(bounds());
+    for (int y = area.y; y < area.bottom(); y++) {
+        memset(row(y) + area.x * 3, 0, (size_t)area.width * 3);
+        if (mask_stride) {
+            uint8_t* mask_row = &mask[(size_t)y * mask_stride];
+            for (int x = area.x; x < area.right(); x++) {
+                mask_row[x >> 3] &= (uint8_t)~(0x80 >> (x & 7));
+            }
+        }
+    }
+}
+
+void Surface::copyFrom(const Surface& src, const Rect& rect) {
+    Rect area = rect.intersect(bounds()).intersect(src.bounds());
+    for (int y = area.y; y < area.bottom(); y++) {
+        memcpy(row(y) + area.x * 3, src.row(y) + area.x * 3, (size_t)area.width * 3);
+    }
+}
+
+void Surface::blendFrom(const Surface& src, const Rect& rect) {
+    if (!src.hasMask()) return;
+    Rect area = rect.intersect(bounds()).intersect(src.bounds());
+    for (int y = area.y; y < area.bottom(); y++) {
+        blitMaskedRow(row(y), src.row(y), src.maskRow(y), area.x, area.width);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Axis-aligned pixel rectangle
+struct Rect {
+    int x, y, width, height;
+
+    Rect() : x(0), y(0), width(0), height(0) {}
+    Rect(int x_, int y_, int width_, int height_) : x(x_), y(y_), width(width_), height(height_) {}
+
+    bool empty() const { return width <= 0 || height <= 0; }
+    int right() const { return x + width; }
+    int bottom() const { return y + height; }
+
+    Rect intersect(const Rect& other) const;
+    Rect unite(const Rect& other) const;  // Bounding box of both
+    bool intersects(const Rect& other) const { return !intersect(other).empty(); }
+    bool contains(int px, int py) const {
+        return px >= x && px < x + width && py >= y && py < y + height;
+    }
+};
+
+// In-memory RGB888 image, rows stored top to bottom without padding.
+// The compositor draws elements here and pushes changed areas to the canvas.
+// A surface created with a mask also records which pixels were drawn, so it
+// can be laid over another surface with blendFrom().
+class Surface {
+public:
+    Surface() : surface_width(0), surface_height(0), mask_stride(0) {}
+
+    void resize(int width, int height, bool with_mask = false);
+
+    int width() const { return surface_width; }
+    int height() const { return surface_height; }
+    size_t stride() const { return (size_t)surface_width * 3; }
+    Rect bounds() const { return Rect(0, 0, surface_width, surface_height); }
+
+    uint8_t* row(int y) { return &pixels[(size_t)y * stride()]; }
+    const uint8_t* row(int y) const { return &pixels[(size_t)y * stride()]; }
+
+    bool hasMask() const { return mask_stride != 0; }
+    const uint8_t* maskRow(int y) const { return &mask[(size_t)y * mask_stride]; }
+
+    // No bounds check - callers clip first
+    void setPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+        uint8_t* p = row(y) + x * 3;
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+        if (mask_stride) {
+            mask[(size_t)y * mask_stride + (x >> 3)] |= (uint8_t)(0x80 >> (x & 7));
+        }
+    }
+
+    void clear();
+    void clear(const Rect& rect);
+
+    // Copy rect from a surface of the same size
+    void copyFrom(const Surface& src, const Rect& rect);
+    // Copy only the pixels drawn on src (src must have a mask)
+    void blendFrom(const Surface& src, const Rect& rect);
+
+private:
+    int surface_width;
+    int surface_height;
+    size_t mask_stride;          // 0 = no mask
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> mask;   // 1 bit per pixel, MSB first, 1 = drawn
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// UTF-8 decoding for the text path. The ESP32 sends display text as UTF-8
+// (Polish letters are two-byte sequences); a byte that does not start a
+// valid sequence is taken as a Latin-1 character, so plain 8-bit text still
+// shows as it did before.
+
+// Code point starting at text[*pos]; advances *pos past it
+inline uint32_t utf8Next(const std::string& text, size_t* pos) {
+    const size_t i = *pos;
+    const uint8_t lead = (uint8_t)text[i];
+    if (lead < 0x80) {
+        *pos = i + 1;
+        return lead;
+    }
+
+    int length;
+    uint32_t code_point;
+    uint32_t min_code_point;  // Smallest value this length may encode (rejects overlong forms)
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        code_point = lead & 0x1F;
+        min_code_point = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        code_point = lead & 0x0F;
+        min_code_point = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        code_point = lead & 0x07;
+        min_code_point = 0x10000;
+    } else {
+        *pos = i + 1;
+        return lead;
+    }
+
+    if (i + length > text.size()) {
+        *pos = i + 1;
+        return lead;
+    }
+    for (int k = 1; k < length; k++) {
+        const uint8_t next = (uint8_t)text[i + k];
+        if ((next & 0xC0) != 0x80) {
+            *pos = i + 1;
+            return lead;
+        }
+        code_point = (code_point << 6) | (next & 0x3F);
+    }
+    if (code_point < min_code_point || code_point > 0x10FFFF ||
+        (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        *pos = i + 1;
+        return lead;
+    }
+
+    *pos = i + length;
+    return code_point;
+}
+
+// Number of characters (code points) in text
+inline size_t utf8Length(const std::string& text) {
+    size_t count = 0;
+    for (size_t pos = 0; pos < text.size(); count++) {
+        utf8Next(text, &pos);
+    }
+    return count;
+}
+
+// Byte offset of the character after the first count characters
+inline size_t utf8Skip(const std::string& text, size_t count) {
+    size_t pos = 0;
+    while (count > 0 && pos < text.size()) {
+        utf8Next(text, &pos);
+        count--;
+    }
+    return pos;
+}
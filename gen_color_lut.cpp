@@ -0,0 +1,46 @@
+// gen-color-lut: build step that writes ColorLut.cpp, the RGB -> palette
+// index table behind ColorPalette::rgbTo8bitFast(). Running the nearest
+// colour search here keeps it (and the table's memory) out of startup.
+//
+// Usage: gen-color-lut <output.cpp>
+#include "ColorPalette.h"
+#include <cstdio>
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <output.cpp>\n", argv[0]);
+        return 1;
+    }
+
+    const char* out_path = argv[1];
+    FILE* out = fopen(out_path, "w");
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+
+    ColorPalette::initialize();
+
+    fprintf(out, "// Generated by gen-color-lut (gen_color_lut.cpp) - do not edit\n");
+    fprintf(out, "#include \"ColorPalette.h\"\n\n");
+    fprintf(out, "const uint8_t ColorPalette::rgb_lookup[64][64][64] = {\n");
+    for (int r = 0; r < 64; r++) {
+        fprintf(out, "{\n");
+        for (int g = 0; g < 64; g++) {
+            fprintf(out, "{");
+            for (int b = 0; b < 64; b++) {
+                // Each entry covers the 4x4x4 colours sharing the top 6 bits
+                fprintf(out, "%d,", ColorPalette::rgbTo8bit(r << 2, g << 2, b << 2));
+            }
+            fprintf(out, "},\n");
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "};\n");
+
+    if (fclose(out) != 0) {
+        perror(out_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+// liv-assetc - pre-bake GIFs into the persistent frame cache
+//
+// Decodes every GIF listed in a manifest at the listed size and writes its
+// frame file into the cache directory, so led-image-viewer can mmap the
+// frames at startup instead of running GraphicsMagick.
+//
+// Usage: liv-assetc [--cache-dir <dir>] [--color-mode palette256|truecolor] [manifest]
+//        (defaults: --cache-dir cache, --color-mode palette256,
+//         manifest anim/manifest.txt; use the screen's color_mode)
+
+#include "GifLoader.h"
+#include "DiskFrameCache.h"
+#include <Magick++.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+static uint64_t GetTimeInMillis() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+int main(int argc, char *argv[]) {
+    Magick::InitializeMagick(argv[0]);
+
+    std::string cache_dir = "cache";
+    std::string manifest = "anim/manifest.txt";
+    ColorMode color_mode = COLOR_MODE_PALETTE256;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--color-mode") == 0 && i + 1 < argc &&
+                   parseColorMode(argv[i + 1], &color_mode)) {
+            i++;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--cache-dir <dir>] [--color-mode palette256|truecolor] [manifest]\n",
+                    argv[0]);
+            return 1;
+        } else {
+            manifest = argv[i];
+        }
+    }
+
+    std::ifstream file(manifest);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open manifest: %s\n", manifest.c_str());
+        return 1;
+    }
+
+    DiskFrameCache::setDirectory(cache_dir);
+
+    int baked = 0, failed = 0;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream iss(line);
+        std::string gif;
+        int width = 0, height = 0;
+        if (!(iss >> gif >> width >> height) || width <= 0 || height <= 0) {
+            fprintf(stderr, "%s:%d: expected '<gif> <width> <height>'\n", manifest.c_str(), line_number);
+            failed++;
+            continue;
+        }
+
+        // decode() maps an up to date frame file or decodes and writes a new one
+        const uint64_t start_ms = GetTimeInMillis();
+        std::string err_msg;
+        std::shared_ptr<const FrameStore> frames = GifLoader::decode(gif, width, height, color_mode, &err_msg);
+        if (!frames) {
+            fprintf(stderr, "FAILED %s %dx%d: %s\n", gif.c_str(), width, height, err_msg.c_str());
+            failed++;
+            continue;
+        }
+
+        printf("%-8s %s %dx%d: %zu frames, %zu KB, %llu ms\n",
+               frames->isMapped() ? "cached" : "baked", gif.c_str(), width, height,
+               frames->frameCount(), frames->memoryBytes() / 1024,
+               (unsigned long long)(GetTimeInMillis() - start_ms));
+        baked++;
+    }
+
+    printf("%d assets in %s (%s), %d failed\n", baked, cache_dir.c_str(),
+           colorModeName(color_mode), failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,601 @@
+// liv-bench - micro-benchmarks for the render hot paths
+//
+// Times colour conversion, BDF font loading, glyph drawing, GIF frame blits,
+// GIF decoding and serial packet parsing with the same code the viewer runs,
+// headless (MemoryRenderTarget). Reports ns/op and heap allocations/op
+// (malloc/calloc/realloc calls, which includes operator new) and writes JSON
+// that can be diffed between builds.
+//
+// Usage: liv-bench [--filter <substring>] [--min-time-ms <ms>] [--json <file>]
+//        Run from the repository root (reads fonts/ and anim/manifest.txt).
+
+#include "DisplayManager.h"
+#include "MemoryRenderTarget.h"
+#include "LedImgViewer.h"
+#include "ColorPalette.h"
+#include "RowKernels.h"
+#include "BdfFont.h"
+#include "Utf8.h"
+#include "SerialProtocol.h"
+#include <Magick++.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Heap allocation counter: the glibc allocator entry points are wrapped so
+// C allocations (SerialProtocol commands, GraphicsMagick) are counted too
+static std::atomic<uint64_t> allocation_count(0);
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+static uint64_t GetTimeInNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Keeps results alive so the optimizer cannot drop the measured work
+static volatile uint32_t sink;
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    size_t bytes_per_op;  // Input bytes per op (throughput benchmarks), else 0
+};
+
+// The code under test logs a lot to stdout; it goes to /dev/null while a
+// benchmark runs (the cost of producing it is still measured)
+class QuietStdout {
+public:
+    QuietStdout() {
+        std::cout.flush();
+        fflush(stdout);
+        saved_fd = dup(STDOUT_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+    }
+    ~QuietStdout() {
+        std::cout.flush();
+        fflush(stdout);
+        if (saved_fd >= 0) {
+            dup2(saved_fd, STDOUT_FILENO);
+            close(saved_fd);
+        }
+    }
+
+private:
+    int saved_fd;
+};
+
+class RenderBenchmarks {
+public:
+    RenderBenchmarks(const std::string& filter, uint64_t min_time_ns)
+        : filter(filter), min_time_ns(min_time_ns) {}
+
+    void runAll();
+    bool writeJson(const std::string& path) const;
+
+private:
+    // Time fn() (which does ops_per_call operations) for at least
+    // min_time_ns; ns/op is the median of 5 batches
+    template <typename F>
+    void run(const std::string& name, F fn, uint64_t ops_per_call = 1, size_t bytes_per_op = 0);
+    bool selected(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    void benchColorPalette();
+    void benchFontLoading();
+    void benchGlyphLookup();
+    void benchGlyphDrawing(DisplayManager& display);
+    void benchGifBlit(DisplayManager& display);
+    void benchGifDecode();
+    void benchSerialParsing();
+
+    std::string filter;
+    uint64_t min_time_ns;
+    std::vector<BenchResult> results;
+};
+
+template <typename F>
+void RenderBenchmarks::run(const std::string& name, F fn, uint64_t ops_per_call, size_t bytes_per_op) {
+    if (!selected(name)) return;
+
+    static const int BATCHES = 5;
+    std::vector<double> batch_ns_per_op;
+    uint64_t total_calls = 0;
+    uint64_t allocations = 0;
+    {
+        QuietStdout quiet;
+
+        fn(); // Warm up caches, lazy initialization and the font cache
+
+        // Calls per batch so that all batches together take min_time_ns
+        uint64_t calls = 1;
+        while (true) {
+            const uint64_t start = GetTimeInNanos();
+            for (uint64_t i = 0; i < calls; i++) fn();
+            const uint64_t elapsed = GetTimeInNanos() - start;
+            if (elapsed * BATCHES >= min_time_ns || calls >= (1ULL << 30)) break;
+            calls = elapsed == 0 ? calls * 100
+                                 : std::max(calls * 2, calls * min_time_ns / (elapsed * BATCHES) + 1);
+        }
+
+        for (int batch = 0; batch < BATCHES; batch++) {
+            const uint64_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+            const uint64_t start = GetTimeInNanos();
+            for (uint64_t i = 0; i < calls; i++) fn();
+            const uint64_t elapsed = GetTimeInNanos() - start;
+            allocations += allocation_count.load(std::memory_order_relaxed) - allocations_before;
+            batch_ns_per_op.push_back((double)elapsed / (calls * ops_per_call));
+        }
+        total_calls = calls * BATCHES;
+    }
+
+    std::sort(batch_ns_per_op.begin(), batch_ns_per_op.end());
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = total_calls * ops_per_call;
+    result.ns_per_op = batch_ns_per_op[BATCHES / 2];
+    result.allocs_per_op = (double)allocations / result.iterations;
+    result.bytes_per_op = bytes_per_op;
+    results.push_back(result);
+
+    printf("%-48s %14.1f ns/op %10.2f allocs/op", name.c_str(), result.ns_per_op, result.allocs_per_op);
+    if (bytes_per_op > 0) {
+        printf(" %8.1f MB/s", bytes_per_op * 1000.0 / result.ns_per_op);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+void RenderBenchmarks::benchColorPalette() {
+    ColorPalette::initialize();
+
+    // 4096 colours spread over the RGB cube, one conversion per op
+    std::vector<uint8_t> colors(4096 * 3);
+    for (size_t i = 0; i < colors.size(); i++) {
+        colors[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+    const uint64_t count = colors.size() / 3;
+
+    run("color/rgbTo8bit", [&]() {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < colors.size(); i += 3) {
+            sum += ColorPalette::rgbTo8bit(colors[i], colors[i + 1], colors[i + 2]);
+        }
+        sink = sum;
+    }, count);
+
+    run("color/rgbTo8bitFast", [&]() {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < colors.size(); i += 3) {
+            sum += ColorPalette::rgbTo8bitFast(colors[i], colors[i + 1], colors[i + 2]);
+        }
+        sink = sum;
+    }, count);
+
+    run("color/mapColor/palette256", [&]() {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < colors.size(); i += 3) {
+            sum += ColorPalette::mapColor(colors[i], colors[i + 1], colors[i + 2], COLOR_MODE_PALETTE256).g;
+        }
+        sink = sum;
+    }, count);
+
+    std::vector<uint8_t> indices(192);
+    std::vector<uint8_t> row(192 * 3);
+    for (size_t i = 0; i < indices.size(); i++) indices[i] = (uint8_t)(i * 37);
+    run("color/expand_palette/192px", [&]() {
+        rowKernels().expand_palette(row.data(), indices.data(), indices.size(), ColorPalette::packed);
+        sink = row[100];
+    });
+}
+
+static std::vector<std::string> listFonts() {
+    std::vector<std::string> fonts;
+    DIR* dir = opendir("fonts");
+    if (!dir) return fonts;
+
+    while (struct dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".bdf") == 0) {
+            fonts.push_back("fonts/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(fonts.begin(), fonts.end());
+    return fonts;
+}
+
+static size_t fileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void RenderBenchmarks::benchFontLoading() {
+    // Parse throughput per font (MB/s of BDF text), then the whole of fonts/
+    // as one op: roughly the hitch of a first lazy load in drawTextElement
+    const std::vector<std::string> fonts = listFonts();
+    size_t total_bytes = 0;
+    for (const std::string& path : fonts) {
+        const size_t bytes = fileSize(path);
+        total_bytes += bytes;
+        run("font/load/" + path.substr(6), [&]() {
+            BdfFont font;
+            sink = font.loadBdf(path);
+        }, 1, bytes);
+    }
+    run("font/load/all", [&]() {
+        for (const std::string& path : fonts) {
+            BdfFont font;
+            sink = font.loadBdf(path);
+        }
+    }, 1, total_bytes);
+
+    // Lazy load as loadFromFile does without a compiled font: the STARTCHAR
+    // index, then only the glyphs of a score ("0".."9" and ":")
+    for (const std::string& path : fonts) {
+        run("font/lazy/" + path.substr(6), [&]() {
+            BdfFont font;
+            sink = font.loadBdf(path, true);
+            for (const char* c = "0123456789:"; *c; c++) {
+                sink = font.getChar((uint8_t)*c) != nullptr;
+            }
+        }, 1, fileSize(path));
+    }
+
+    // The same fonts compiled by liv-fontc, mapped (into a scratch directory,
+    // so fonts/ is left alone)
+    if (!selected("font/map/")) return;
+    char scratch[] = "/tmp/liv-bench-fonts.XXXXXX";
+    if (!mkdtemp(scratch)) return;
+    std::vector<std::string> compiled;
+    {
+        QuietStdout quiet;
+        for (const std::string& path : fonts) {
+            BdfFont font;
+            const std::string output = std::string(scratch) + "/" + BdfFont::compiledPath(path.substr(6));
+            if (font.loadBdf(path) && font.writeCompiled(output)) {
+                compiled.push_back(output);
+            }
+        }
+    }
+    for (const std::string& path : compiled) {
+        run("font/map/" + path.substr(strlen(scratch) + 1), [&]() {
+            BdfFont font;
+            sink = font.loadFromFile(path);
+        });
+    }
+    run("font/map/all", [&]() {
+        for (const std::string& path : compiled) {
+            BdfFont font;
+            sink = font.loadFromFile(path);
+        }
+    });
+    for (const std::string& path : compiled) {
+        unlink(path.c_str());
+    }
+    rmdir(scratch);
+}
+
+void RenderBenchmarks::benchGlyphLookup() {
+    BdfFont font;
+    {
+        QuietStdout quiet;
+        font.loadFromFile("fonts/10x20.bdf");
+    }
+
+    // Dense table (ASCII, Polish letters) and the hash above it, with the
+    // UTF-8 decoding the text path does
+    const std::string polish = "Zażółć gęślą jaźń";
+    const std::string symbols = "\u2190\u2191\u2192\u2193\u2605\u2606\u20ac\u2122";
+    run("font/getChar/polish", [&]() {
+        int advance = 0;
+        for (size_t pos = 0; pos < polish.size();) {
+            const BdfChar* glyph = font.getChar(utf8Next(polish, &pos));
+            advance += glyph ? glyph->dwidth : 0;
+        }
+        sink = advance;
+    }, utf8Length(polish));
+    run("font/getChar/symbols", [&]() {
+        int advance = 0;
+        for (size_t pos = 0; pos < symbols.size();) {
+            const BdfChar* glyph = font.getChar(utf8Next(symbols, &pos));
+            advance += glyph ? glyph->dwidth : 0;
+        }
+        sink = advance;
+    }, utf8Length(symbols));
+}
+
+void RenderBenchmarks::benchGlyphDrawing(DisplayManager& display) {
+    Surface surface;
+    surface.resize(display.SCREEN_WIDTH, display.SCREEN_HEIGHT);
+    const Rect screen = surface.bounds();
+    const Color8 color(255, 200, 0);
+
+    // Default 5x7 font, through drawChar
+    run("text/drawChar/5x7", [&]() {
+        display.drawChar('A', 10, 10, 1, color, surface, screen);
+    });
+    run("text/drawChar/5x7/scale3", [&]() {
+        display.drawChar('A', 10, 10, 3, color, surface, screen);
+    });
+
+    // A score line in each font, through drawTextElement (default font via
+    // drawString / drawChar, the others through the font cache)
+    DisplayElement element;
+    element.type = DisplayElement::TEXT;
+    element.active = true;
+    element.x = 4;
+    element.y = 40;
+    element.text = "SCORE 123456";
+    element.color = color;
+    for (const std::string& path : listFonts()) {
+        element.font_name = path;
+        run("text/drawTextElement/" + path.substr(6), [&]() {
+            display.drawTextElement(element, surface, screen);
+        }, element.text.size());
+    }
+}
+
+// path decoded and scaled to width x height
+static std::shared_ptr<const FrameStore> loadFrames(const std::string& path, int width, int height) {
+    std::vector<Magick::Image> images;
+    std::string err_msg;
+    if (!LoadImageAndScale(path.c_str(), width, height, false, false, &images, &err_msg)) {
+        std::cerr << "Cannot load " << path << ": " << err_msg << std::endl;
+        return nullptr;
+    }
+    return FrameStore::fromImages(images, COLOR_MODE_PALETTE256);
+}
+
+void RenderBenchmarks::benchGifBlit(DisplayManager& display) {
+    Surface surface;
+    surface.resize(display.SCREEN_WIDTH, display.SCREEN_HEIGHT);
+    const Rect screen = surface.bounds();
+
+    struct BlitCase { const char* file; int width; int height; };
+    static const BlitCase cases[] = {
+        {"anim/2.gif", 192, 192},
+        {"anim/pilka.gif", 64, 64},
+    };
+
+    const std::vector<const RowKernels*> variants = availableRowKernels();
+    for (const BlitCase& blit : cases) {
+        const std::string size = std::to_string(blit.width) + "x" + std::to_string(blit.height);
+        bool any_selected = selected("gif/blit/" + size);
+        for (const RowKernels* kernels : variants) {
+            any_selected = any_selected || selected("gif/masked_copy/" + size + "/" + kernels->name);
+        }
+        if (!any_selected) continue; // Skip the decode too
+
+        std::shared_ptr<const FrameStore> frames = loadFrames(blit.file, blit.width, blit.height);
+        if (!frames) continue;
+
+        DisplayElement element;
+        element.type = DisplayElement::GIF;
+        element.active = true;
+        element.width = blit.width;
+        element.height = blit.height;
+        element.gif_frames = frames;
+        size_t frame = 0;
+        run("gif/blit/" + size, [&]() {
+            element.current_frame = frame++ % frames->frameCount();
+            display.drawGifElement(element, surface, screen);
+        });
+
+        // The row kernel alone, per CPU variant, over a whole frame
+        const PackedFrame& packed = frames->frame(0);
+        for (const RowKernels* kernels : variants) {
+            run("gif/masked_copy/" + size + "/" + kernels->name, [&]() {
+                for (int y = 0; y < frames->height(); y++) {
+                    kernels->masked_copy(surface.row(y), packed.rgb + (size_t)y * frames->width() * 3,
+                                         packed.mask + y * frames->maskStride(), 0, frames->width());
+                }
+            });
+        }
+    }
+}
+
+void RenderBenchmarks::benchGifDecode() {
+    std::ifstream manifest("anim/manifest.txt");
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream iss(line);
+        std::string gif;
+        int width = 0, height = 0;
+        if (!(iss >> gif >> width >> height)) continue;
+
+        run("gif/LoadImageAndScale/" + gif.substr(gif.rfind('/') + 1) + "/" +
+            std::to_string(width) + "x" + std::to_string(height), [&]() {
+            std::vector<Magick::Image> images;
+            std::string err_msg;
+            sink = LoadImageAndScale(gif.c_str(), width, height, false, false, &images, &err_msg);
+        });
+    }
+}
+
+// One protocol packet as the ESP32 sends it: preamble, SOF, header,
+// payload (the command struct), XOR checksum, EOF
+static void appendPacket(std::vector<uint8_t>* out, uint8_t screen_id, uint8_t command,
+                         const void* payload, uint8_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < length; i++) checksum ^= bytes[i];
+
+    const uint8_t header[] = {PROTOCOL_PREAMBLE_1, PROTOCOL_PREAMBLE_2, PROTOCOL_PREAMBLE_3,
+                              PROTOCOL_SOF, screen_id, command, length};
+    out->insert(out->end(), header, header + sizeof(header));
+    out->insert(out->end(), bytes, bytes + length);
+    out->push_back(checksum);
+    out->push_back(PROTOCOL_EOF);
+}
+
+void RenderBenchmarks::benchSerialParsing() {
+    SerialProtocol protocol;  // Not opened: responses go nowhere
+
+    TextCommand text;
+    memset(&text, 0, sizeof(text));
+    text.screen_id = 1;
+    text.command = CMD_DISPLAY_TEXT;
+    text.element_id = 3;
+    text.x_pos = 10;
+    text.y_pos = 20;
+    text.color_r = 255;
+    strcpy(text.text, "SCORE 123456");
+    text.text_length = strlen(text.text);
+    strcpy(text.font_name, "ComicNeue-Regular-20.bdf");
+
+    GifCommand gif;
+    memset(&gif, 0, sizeof(gif));
+    gif.screen_id = 1;
+    gif.command = CMD_LOAD_GIF;
+    gif.element_id = 1;
+    gif.width = 192;
+    gif.height = 192;
+    strcpy(gif.filename, "anim/2.gif");
+
+    std::vector<uint8_t> text_packet, gif_packet, noisy_packet;
+    appendPacket(&text_packet, 1, CMD_DISPLAY_TEXT, &text, sizeof(text));
+    appendPacket(&gif_packet, 1, CMD_LOAD_GIF, &gif, sizeof(gif));
+    // Line noise before the packet, as after an ESP32 reset
+    noisy_packet.assign(40, 0x00);
+    noisy_packet.insert(noisy_packet.end(), text_packet.begin(), text_packet.end());
+
+    struct ParseCase { const char* name; const std::vector<uint8_t>* bytes; };
+    const ParseCase cases[] = {
+        {"serial/processBytes/text", &text_packet},
+        {"serial/processBytes/gif", &gif_packet},
+        {"serial/processBytes/text_after_noise", &noisy_packet},
+    };
+    for (const ParseCase& parse : cases) {
+        run(parse.name, [&]() {
+            protocol.processBytes(parse.bytes->data(), parse.bytes->size(), GetTimeInNanos() / 1000);
+            while (void* command = protocol.getNextCommand()) {
+                protocol.freeCommand(command);
+            }
+        }, 1, parse.bytes->size());
+    }
+}
+
+void RenderBenchmarks::runAll() {
+    benchColorPalette();
+    benchFontLoading();
+    benchGlyphLookup();
+    benchGifDecode();
+    benchSerialParsing();
+
+    // Declared before display, so its shutdown log is silenced as well
+    std::unique_ptr<QuietStdout> quiet(new QuietStdout());
+    MemoryRenderTarget target(192, 192);
+    DisplayManager display(&target);
+    quiet.reset();
+
+    benchGlyphDrawing(display);
+    benchGifBlit(display);
+
+    quiet.reset(new QuietStdout());
+}
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool RenderBenchmarks::writeJson(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n  \"row_kernels\": \"%s\",\n  \"min_time_ms\": %llu,\n  \"benchmarks\": [\n",
+            rowKernels().name, (unsigned long long)(min_time_ns / 1000000));
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, "
+                "\"allocs_per_op\": %.3f, \"bytes_per_op\": %zu}%s\n",
+                jsonEscape(result.name).c_str(), (unsigned long long)result.iterations,
+                result.ns_per_op, result.allocs_per_op, result.bytes_per_op,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    Magick::InitializeMagick(argv[0]);
+
+    std::string filter;
+    std::string json_path;
+    uint64_t min_time_ms = 200;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc) {
+            min_time_ms = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time-ms <ms>] [--json <file>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("liv-bench: row kernels %s, min time %llu ms per benchmark\n",
+           rowKernels().name, (unsigned long long)min_time_ms);
+
+    RenderBenchmarks benchmarks(filter, min_time_ms * 1000000);
+    benchmarks.runAll();
+
+    if (!json_path.empty() && !benchmarks.writeJson(json_path)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// liv-fontc - compile BDF fonts into mmap-ready font files
+//
+// Parses each BDF font and writes it next to the source as a compiled font
+// (fonts/5x7.bdf -> fonts/5x7.livfont). BdfFont::loadFromFile maps the
+// compiled file read-only instead of parsing the BDF text, as long as it is
+// newer than the BDF file.
+//
+// Usage: liv-fontc [font.bdf ...]
+//        (default: every fonts/*.bdf, run from the repository root)
+
+#include "BdfFont.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static uint64_t GetTimeInMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static std::vector<std::string> listFonts() {
+    std::vector<std::string> fonts;
+    DIR* dir = opendir("fonts");
+    if (!dir) return fonts;
+
+    while (struct dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".bdf") == 0) {
+            fonts.push_back("fonts/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(fonts.begin(), fonts.end());
+    return fonts;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> fonts;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [font.bdf ...]\n", argv[0]);
+            return 1;
+        }
+        fonts.push_back(argv[i]);
+    }
+    if (fonts.empty()) {
+        fonts = listFonts();
+    }
+    if (fonts.empty()) {
+        fprintf(stderr, "No fonts given and no fonts/*.bdf found\n");
+        return 1;
+    }
+
+    // The parser logs font properties to stdout; only the summary lines are wanted
+    fflush(stdout);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    int compiled = 0, failed = 0;
+    for (const std::string& bdf : fonts) {
+        const uint64_t start_us = GetTimeInMicros();
+        const std::string output = BdfFont::compiledPath(bdf);
+
+        fflush(stdout);
+        if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+        BdfFont font;
+        const bool ok = font.loadBdf(bdf) && font.glyphCount() > 0 && font.writeCompiled(output);
+        fflush(stdout);
+        if (saved_stdout >= 0) dup2(saved_stdout, STDOUT_FILENO);
+
+        if (!ok) {
+            fprintf(stderr, "FAILED %s\n", bdf.c_str());
+            failed++;
+            continue;
+        }
+        printf("%-40s %5zu glyphs, %4zu KB, %llu us\n", output.c_str(), font.glyphCount(),
+               (font.memoryBytes() + 1023) / 1024, (unsigned long long)(GetTimeInMicros() - start_us));
+        compiled++;
+    }
+
+    printf("%d fonts compiled, %d failed\n", compiled, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+// liv-replay - replays a recorded serial session (serial_capture / --capture)
+//
+// Feeds the captured bytes through the same SerialProtocol parser and
+// DisplayManager as the viewer, headless, either at the original timing
+// (the render loop runs between records like on the Pi) or as fast as
+// possible (one frame per record). Reports parse/apply throughput and the
+// command-to-frame latency: time from handing a record's bytes to the parser
+// until the frame showing its commands has been swapped, and the viewer's
+// own per-stage command latency histograms (see LatencyTrace.h).
+//
+// Usage: liv-replay <capture> [--config <ini>] [--fast] [--tail-ms <ms>]
+//                   [--dump <file.y4m|file.ppm>] [--json <file>] [--trace <file>]
+//                   [--verbose]
+//        Run from the repository root (reads fonts/ and anim/).
+
+#include "DisplayManager.h"
+#include "MemoryRenderTarget.h"
+#include "ScreenConfig.h"
+#include "SerialCapture.h"
+#include "AssetCache.h"
+#include "DiskFrameCache.h"
+#include "LatencyTrace.h"
+#include "FrameProfiler.h"
+#include <Magick++.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static uint64_t GetTimeInMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static void SleepUntilMicros(uint64_t time_us) {
+    struct timespec ts;
+    ts.tv_sec = time_us / 1000000ULL;
+    ts.tv_nsec = (time_us % 1000000ULL) * 1000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+// Nearest-rank percentile of sorted values
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+struct ReplayStats {
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t commands;
+    uint64_t capture_us;  // Time span of the capture
+    uint64_t wall_us;     // Time the replay took
+    uint64_t parse_us;    // Spent in parsing and applying commands
+    uint64_t frames;
+    std::vector<uint64_t> latency_us;  // Command-to-frame, per record with commands
+};
+
+// Render loop between records: frames at their deadlines until until_us
+static void renderUntil(DisplayManager& display, uint64_t until_us) {
+    while (true) {
+        uint64_t now = GetTimeInMicros();
+        if (now >= until_us) return;
+
+        uint64_t deadline = display.nextDeadlineUs();
+        if (deadline > now) {
+            SleepUntilMicros(std::min(deadline, until_us));
+            if (deadline > until_us) return;
+        }
+        display.updateDisplay();
+    }
+}
+
+static bool writeJson(const std::string& path, const std::string& capture, bool fast, const ReplayStats& stats) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n  \"capture\": \"%s\",\n  \"mode\": \"%s\",\n", capture.c_str(), fast ? "fast" : "realtime");
+    fprintf(file, "  \"records\": %llu,\n  \"bytes\": %llu,\n  \"commands\": %llu,\n  \"frames\": %llu,\n",
+            (unsigned long long)stats.records, (unsigned long long)stats.bytes,
+            (unsigned long long)stats.commands, (unsigned long long)stats.frames);
+    fprintf(file, "  \"capture_us\": %llu,\n  \"wall_us\": %llu,\n  \"parse_us\": %llu,\n",
+            (unsigned long long)stats.capture_us, (unsigned long long)stats.wall_us,
+            (unsigned long long)stats.parse_us);
+    fprintf(file, "  \"latency_p50_us\": %llu,\n  \"latency_p99_us\": %llu,\n  \"latency_max_us\": %llu\n}\n",
+            (unsigned long long)percentile(stats.latency_us, 50),
+            (unsigned long long)percentile(stats.latency_us, 99),
+            (unsigned long long)(stats.latency_us.empty() ? 0 : stats.latency_us.back()));
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    Magick::InitializeMagick(argv[0]);
+
+    std::string capture_path;
+    std::string config_file;
+    std::string dump_path;
+    std::string json_path;
+    std::string trace_path;
+    bool fast = false;
+    bool verbose = false;
+    uint64_t tail_ms = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            config_file = argv[++i];
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            fast = true;
+        } else if (strcmp(argv[i], "--tail-ms") == 0 && i + 1 < argc) {
+            tail_ms = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dump_path = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (argv[i][0] != '-' && capture_path.empty()) {
+            capture_path = argv[i];
+        } else {
+            capture_path.clear();
+            break;
+        }
+    }
+    if (capture_path.empty()) {
+        fprintf(stderr, "Usage: %s <capture> [--config <ini>] [--fast] [--tail-ms <ms>] "
+                "[--dump <file.y4m|file.ppm>] [--json <file>] [--trace <file>] [--verbose]\n", argv[0]);
+        return 1;
+    }
+
+    ScreenConfig config;
+    if (!config_file.empty() && !config.loadFromFile(config_file)) {
+        return 1;
+    }
+    // The panels report the V-mapper rotated size; mirror that here
+    int width = config.cols * config.chain_length;
+    int height = config.rows * config.parallel;
+    if (config.pixel_mapper == "V-mapper") {
+        std::swap(width, height);
+    }
+
+    SerialCaptureReader reader;
+    std::string err_msg;
+    if (!reader.open(capture_path, &err_msg)) {
+        fprintf(stderr, "Cannot read %s: %s\n", capture_path.c_str(), err_msg.c_str());
+        return 1;
+    }
+
+    AssetCache::instance().setBudget((size_t)std::max(config.asset_cache_mb, 0) * 1024 * 1024);
+    DiskFrameCache::setDirectory(config.frame_cache_dir);
+
+    std::unique_ptr<MemoryRenderTarget> target;
+    if (dump_path.empty()) {
+        target.reset(new MemoryRenderTarget(width, height));
+    } else {
+        const bool ppm = dump_path.size() > 4 && dump_path.compare(dump_path.size() - 4, 4, ".ppm") == 0;
+        FrameDumpRenderTarget* dump = new FrameDumpRenderTarget(width, height, dump_path,
+            ppm ? FrameDumpRenderTarget::PPM : FrameDumpRenderTarget::Y4M);
+        target.reset(dump);
+        if (!dump->isOpen()) {
+            return 1;
+        }
+    }
+
+    printf("liv-replay: %s on screen %d (%dx%d, %s), %s\n", capture_path.c_str(), config.screen_id,
+           width, height, colorModeName(config.color_mode), fast ? "as fast as possible" : "original timing");
+    fflush(stdout);
+
+    // The viewer logs every byte and command; keep that off the terminal
+    int saved_stdout = -1;
+    if (!verbose) {
+        saved_stdout = dup(STDOUT_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+    }
+
+    ReplayStats stats = ReplayStats();
+    std::unique_ptr<LatencyStats> stages(new LatencyStats());
+    {
+        DisplayManager display(target.get(), false, config.screen_id, config.color_mode);
+
+        // Arrival times are handed to the parser on the replay's own time
+        // base, so restart detection sees the original gaps in both modes
+        const uint64_t start_us = GetTimeInMicros();
+        const uint64_t swaps_before = target->swapCount();
+        uint64_t time_us = 0;
+        std::vector<uint8_t> data;
+        while (reader.next(&time_us, &data)) {
+            if (!fast) {
+                renderUntil(display, start_us + time_us);
+            }
+
+            const uint64_t fed_us = GetTimeInMicros();
+            const size_t applied = display.replaySerialBytes(data.data(), data.size(), start_us + time_us);
+            stats.parse_us += GetTimeInMicros() - fed_us;
+            if (applied > 0 || fast) {
+                display.updateDisplay();
+            }
+            if (applied > 0) {
+                stats.latency_us.push_back(GetTimeInMicros() - fed_us);
+            }
+
+            stats.records++;
+            stats.bytes += data.size();
+            stats.commands += applied;
+        }
+        stats.capture_us = time_us;
+
+        // Let the last GIF loads and animations come through
+        renderUntil(display, GetTimeInMicros() + tail_ms * 1000);
+
+        stats.wall_us = GetTimeInMicros() - start_us;
+        stats.frames = target->swapCount() - swaps_before;
+        *stages = display.latencyStats();
+    }
+
+    if (saved_stdout >= 0) {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
+
+    std::sort(stats.latency_us.begin(), stats.latency_us.end());
+    const double wall_s = stats.wall_us / 1e6;
+    const double parse_s = stats.parse_us / 1e6;
+    printf("Capture:     %llu records, %llu bytes over %.3f s\n", (unsigned long long)stats.records,
+           (unsigned long long)stats.bytes, stats.capture_us / 1e6);
+    printf("Replay:      %.3f s wall, %llu commands, %llu frames\n", wall_s,
+           (unsigned long long)stats.commands, (unsigned long long)stats.frames);
+    printf("Parse+apply: %.3f s, %.0f commands/s, %.2f MB/s\n", parse_s,
+           parse_s > 0 ? stats.commands / parse_s : 0, parse_s > 0 ? stats.bytes / parse_s / 1e6 : 0);
+    printf("Latency:     command-to-frame p50 %llu us, p99 %llu us, max %llu us\n",
+           (unsigned long long)percentile(stats.latency_us, 50),
+           (unsigned long long)percentile(stats.latency_us, 99),
+           (unsigned long long)(stats.latency_us.empty() ? 0 : stats.latency_us.back()));
+
+    printf("\n");
+    if (fast) {
+        printf("(--fast: serial and total stages count from the original arrival times)\n");
+    }
+    fflush(stdout);
+    stages->dump(std::cout);
+
+    if (!json_path.empty() && !writeJson(json_path, capture_path, fast, stats)) {
+        return 1;
+    }
+    // Timeline of the last frames (LIV_PROFILE builds)
+    if (!trace_path.empty() && !FrameProfiler::writeChromeTrace(trace_path)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,376 @@
+// liv-scene-bench - frame times of the real screen layouts
+//
+// Replays the layouts the ESP32 firmware (pgm/pgm.ino) puts on the two
+// screens - attract mode, the score screen, a tournament round, each on the
+// 192x192 screen and the vertical 64x512 one - as the DISPLAY_TEXT and
+// LOAD_GIF commands it sends, into a headless DisplayManager. The render
+// loop then runs in real time like the viewer's (sleep until
+// nextDeadlineUs(), updateDisplay()) and every updateDisplay() call is timed.
+//
+// Reports p50 / p99 frame time, CPU time per frame and peak RSS per scene.
+// Each scene runs in its own forked process, so peak RSS is the scene's.
+//
+// Usage: liv-scene-bench [--filter <substring>] [--seconds <s>]
+//                        [--color-mode palette256|truecolor] [--json <file>]
+//        Run from the repository root (reads fonts/ and anim/).
+
+#include "DisplayManager.h"
+#include "MemoryRenderTarget.h"
+#include "ColorPalette.h"
+#include "RowKernels.h"
+#include "SerialProtocol.h"
+#include <Magick++.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// One displayText() / loadGif() call of the firmware
+struct SceneCommand {
+    uint8_t command;  // CMD_DISPLAY_TEXT or CMD_LOAD_GIF
+    TextCommand text;
+    GifCommand gif;
+};
+
+// matrix.displayText(text, x, y, size, r, g, b, font, id, blink, screen)
+static SceneCommand displayText(const char* text, uint16_t x, uint16_t y, uint8_t r, uint8_t g, uint8_t b,
+                                const char* font, uint8_t element_id, uint16_t blink_interval_ms) {
+    SceneCommand scene_command;
+    memset(&scene_command, 0, sizeof(scene_command));
+    scene_command.command = CMD_DISPLAY_TEXT;
+
+    TextCommand& cmd = scene_command.text;
+    cmd.command = CMD_DISPLAY_TEXT;
+    cmd.element_id = element_id;
+    cmd.x_pos = x;
+    cmd.y_pos = y;
+    cmd.color_r = r;
+    cmd.color_g = g;
+    cmd.color_b = b;
+    strncpy(cmd.text, text, sizeof(cmd.text) - 1);
+    cmd.text_length = strlen(cmd.text);
+    strncpy(cmd.font_name, font, sizeof(cmd.font_name) - 1);
+    cmd.blink_interval_ms = blink_interval_ms;
+    return scene_command;
+}
+
+// matrix.loadGif(file, x, y, width, height, id, screen)
+static SceneCommand loadGif(const char* file, uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+                            uint8_t element_id) {
+    SceneCommand scene_command;
+    memset(&scene_command, 0, sizeof(scene_command));
+    scene_command.command = CMD_LOAD_GIF;
+
+    GifCommand& cmd = scene_command.gif;
+    cmd.command = CMD_LOAD_GIF;
+    cmd.element_id = element_id;
+    cmd.x_pos = x;
+    cmd.y_pos = y;
+    cmd.width = width;
+    cmd.height = height;
+    strncpy(cmd.filename, file, sizeof(cmd.filename) - 1);
+    return scene_command;
+}
+
+struct Scene {
+    std::string name;
+    int width;
+    int height;
+    uint8_t screen_id;  // 1 = 192x192, 2 = 64x512 (the firmware's screen argument)
+    std::vector<SceneCommand> commands;
+};
+
+// The layouts, call for call as in pgm/pgm.ino (scores and credits filled in
+// with typical values; x positions computed the way the firmware does)
+static std::vector<Scene> firmwareScenes() {
+    std::vector<Scene> scenes;
+
+    // loop(), LedEffectCnt 0: boxer animation under the attract texts
+    scenes.push_back({"attract/192x192", 192, 192, 1, {
+        displayText("*$* Insert Coin *$*", 10, 170, 255, 255, 0, "fonts/9x18B.bdf", 1, 500),
+        displayText("PRO-GAMES POLAND", 25, 5, 255, 255, 0, "fonts/9x18B.bdf", 2, 0),
+        displayText("* Monster 3in1 *", 40, 25, 255, 255, 0, "fonts/7x13.bdf", 3, 0),
+        loadGif("anim/boxer.gif", 36, 38, 120, 120, 0),
+    }});
+
+    // loop(), LedEffectCnt 2: full-screen animation with the texts over it
+    scenes.push_back({"attract_fullscreen/192x192", 192, 192, 1, {
+        displayText("*$* Insert Coin *$*", 10, 170, 255, 255, 0, "fonts/9x18B.bdf", 1, 500),
+        displayText("PRO-GAMES POLAND", 25, 5, 255, 255, 0, "fonts/9x18B.bdf", 2, 0),
+        displayText("* Monster 3in1 *", 40, 25, 255, 255, 0, "fonts/7x13.bdf", 3, 0),
+        loadGif("anim/2.gif", 0, 0, 192, 192, 0),
+    }});
+
+    scenes.push_back({"attract/64x512", 64, 512, 2, {
+        displayText("ProGames", 5, 300, 255, 255, 255, "fonts/7x13.bdf", 31, 0),
+        displayText("Poland", 12, 315, 255, 255, 255, "fonts/7x13.bdf", 32, 0),
+        displayText("Insert", 10, 390, 255, 255, 0, "fonts/7x13.bdf", 33, 400),
+        displayText("Coin", 20, 400, 255, 255, 0, "fonts/7x13.bdf", 34, 400),
+        loadGif("anim/6h.gif", 0, 512 - 64, 64, 64, 10),
+        loadGif("anim/7.gif", 0, 0, 64, 64, 11),
+    }});
+
+    // Naliczanie() over DisplayGameMatrix(): score counted up after a boxer hit
+    scenes.push_back({"score/192x192", 192, 192, 1, {
+        displayText("RECORD", 5, 26, 255, 0, 0, "fonts/9x18B.bdf", 1, 0),
+        displayText("987", 192 / 2 - 3 * 10, 16, 255, 0, 0, "fonts/ComicNeue-Bold-48.bdf", 2, 0),
+        displayText("SCORE", 5, 75, 0, 255, 0, "fonts/9x18B.bdf", 3, 0),
+        displayText("642", 192 / 2 - 3 * 10, 62, 0, 255, 0, "fonts/ComicNeue-Bold-48.bdf", 4, 0),
+        displayText("Credit", 5, 115, 0, 0, 255, "fonts/9x18B.bdf", 5, 0),
+        displayText("3", 192 / 2 - 15, 115, 0, 0, 255, "fonts/9x18B.bdf", 6, 0),
+        displayText("Reaction Time", 40, 130, 255, 255, 0, "fonts/9x18B.bdf", 7, 0),
+        displayText("358ms", (192 - 5 * 19) / 2, 150, 255, 255, 0, "fonts/Verdana-24-r.bdf", 9, 0),
+    }});
+
+    scenes.push_back({"score/64x512", 64, 512, 2, {
+        displayText("RECORD", 5, 10, 255, 0, 0, "fonts/9x18B.bdf", 30, 0),
+        displayText("987", 15, 30, 255, 0, 0, "fonts/9x18B.bdf", 31, 0),
+        displayText("SCORE", 10, 140, 255, 255, 255, "fonts/9x18B.bdf", 32, 0),
+        displayText("642", (64 - 3 * 19) / 2, 155, 255, 255, 255, "fonts/Verdana-24-r.bdf", 33, 0),
+        loadGif("anim/naliczanieHam.gif", 0, 0, 64, 512, 10),
+    }});
+
+    // Tournament round (hammer): the player scores go to the 7-segment
+    // displays, the matrices show DisplayGameMatrix() and the blinking prompt
+    scenes.push_back({"tournament/192x192", 192, 192, 1, {
+        displayText("RECORD", 5, 26, 255, 0, 0, "fonts/9x18B.bdf", 1, 0),
+        displayText("987", 192 / 2 - 1 * 10, 16, 255, 0, 0, "fonts/ComicNeue-Bold-48.bdf", 2, 0),
+        displayText("SCORE", 5, 75, 0, 255, 0, "fonts/9x18B.bdf", 3, 0),
+        displayText("0", 192 / 2 - 1 * 10, 62, 0, 255, 0, "fonts/ComicNeue-Bold-48.bdf", 4, 0),
+        displayText("Credit", 5, 115, 0, 0, 255, "fonts/9x18B.bdf", 5, 0),
+        displayText("3", 192 / 2 - 15, 115, 0, 0, 255, "fonts/9x18B.bdf", 6, 0),
+        displayText("Use the hammer!", 25, 160, 255, 255, 0, "fonts/9x18B.bdf", 7, 300),
+    }});
+
+    scenes.push_back({"tournament/64x512", 64, 512, 2, {
+        displayText("RECORD", 5, 10, 255, 0, 0, "fonts/9x18B.bdf", 30, 0),
+        displayText("987", 15, 30, 255, 0, 0, "fonts/9x18B.bdf", 31, 0),
+        displayText("SCORE", 10, 140, 255, 255, 255, "fonts/9x18B.bdf", 32, 0),
+        displayText("0", (64 - 1 * 19) / 2, 155, 255, 255, 255, "fonts/Verdana-24-r.bdf", 33, 0),
+        displayText("Use", 15, 250, 255, 255, 255, "fonts/9x18B.bdf", 15, 300),
+        displayText("Hammer", 10, 265, 255, 255, 255, "fonts/9x18B.bdf", 16, 300),
+        loadGif("anim/2Vga-resize.gif", 0, 60, 64, 64, 10),
+        loadGif("anim/RedArrowDown.gif", 0, 512 - 73, 64, 73, 21),
+    }});
+
+    return scenes;
+}
+
+struct SceneResult {
+    uint64_t updates;       // updateDisplay() calls
+    uint64_t frames;        // Frames shown (swaps)
+    double p50_us;          // updateDisplay() wall time
+    double p99_us;
+    double cpu_us_per_frame;
+    long peak_rss_kb;
+    bool ok;
+};
+
+static uint64_t GetTimeInNanos(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+class SceneBenchmark {
+public:
+    SceneBenchmark(double seconds, ColorMode color_mode) : seconds(seconds), color_mode(color_mode) {}
+
+    // Runs in the forked child
+    SceneResult run(const Scene& scene);
+
+private:
+    double seconds;
+    ColorMode color_mode;
+};
+
+SceneResult SceneBenchmark::run(const Scene& scene) {
+    SceneResult result;
+    memset(&result, 0, sizeof(result));
+
+    MemoryRenderTarget target(scene.width, scene.height);
+    DisplayManager display(&target, false, scene.screen_id, color_mode);
+
+    for (const SceneCommand& command : scene.commands) {
+        SceneCommand copy = command;
+        if (copy.command == CMD_DISPLAY_TEXT) {
+            copy.text.screen_id = scene.screen_id;
+            display.processTextCommand(&copy.text);
+        } else {
+            copy.gif.screen_id = scene.screen_id;
+            display.processGifCommand(&copy.gif);
+        }
+    }
+
+    // GIF decoding is not part of the frame time: wait for the loader
+    const uint64_t load_deadline = GetTimeInNanos(CLOCK_MONOTONIC) + 60 * 1000000000ULL;
+    while (!display.pending_gif_loads.empty()) {
+        if (GetTimeInNanos(CLOCK_MONOTONIC) > load_deadline) {
+            fprintf(stderr, "%s: GIF loads did not finish\n", scene.name.c_str());
+            return result;
+        }
+        usleep(1000);
+        display.applyLoadedGifs();
+    }
+
+    std::vector<uint64_t> wall_ns;
+    uint64_t cpu_ns = 0;
+    const uint64_t swaps_before = target.swapCount();
+    const uint64_t end = GetTimeInNanos(CLOCK_MONOTONIC) + (uint64_t)(seconds * 1e9);
+    while (GetTimeInNanos(CLOCK_MONOTONIC) < end) {
+        const uint64_t cpu_start = GetTimeInNanos(CLOCK_THREAD_CPUTIME_ID);
+        const uint64_t start = GetTimeInNanos(CLOCK_MONOTONIC);
+        display.updateDisplay();
+        wall_ns.push_back(GetTimeInNanos(CLOCK_MONOTONIC) - start);
+        cpu_ns += GetTimeInNanos(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+
+        // Sleep like waitForEvents(); a static screen sleeps to the end
+        const uint64_t deadline_us = std::min<uint64_t>(display.nextDeadlineUs(), end / 1000);
+        struct timespec ts;
+        ts.tv_sec = deadline_us / 1000000ULL;
+        ts.tv_nsec = (deadline_us % 1000000ULL) * 1000ULL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+
+    std::sort(wall_ns.begin(), wall_ns.end());
+    result.updates = wall_ns.size();
+    result.frames = target.swapCount() - swaps_before;
+    result.p50_us = percentile(wall_ns, 50) / 1000.0;
+    result.p99_us = percentile(wall_ns, 99) / 1000.0;
+    result.cpu_us_per_frame = result.frames ? cpu_ns / 1000.0 / result.frames : 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peak_rss_kb = usage.ru_maxrss;
+    result.ok = true;
+    return result;
+}
+
+// Runs the scene in a child process (its own peak RSS, its log to /dev/null)
+static bool runScene(const Scene& scene, double seconds, ColorMode color_mode, SceneResult* result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+        SceneBenchmark benchmark(seconds, color_mode);
+        SceneResult child_result = benchmark.run(scene);
+        ssize_t written = write(fds[1], &child_result, sizeof(child_result));
+        _exit(written == (ssize_t)sizeof(child_result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got == (ssize_t)sizeof(*result) && WIFEXITED(status) && WEXITSTATUS(status) == 0 && result->ok;
+}
+
+static bool writeJson(const std::string& path, double seconds, ColorMode color_mode,
+                      const std::vector<std::pair<const Scene*, SceneResult> >& results) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n  \"row_kernels\": \"%s\",\n  \"color_mode\": \"%s\",\n  \"seconds\": %.1f,\n  \"scenes\": [\n",
+            rowKernels().name, colorModeName(color_mode), seconds);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Scene& scene = *results[i].first;
+        const SceneResult& result = results[i].second;
+        fprintf(file, "    {\"name\": \"%s\", \"width\": %d, \"height\": %d, \"updates\": %llu, \"frames\": %llu, "
+                "\"p50_us\": %.1f, \"p99_us\": %.1f, \"cpu_us_per_frame\": %.1f, \"peak_rss_kb\": %ld}%s\n",
+                scene.name.c_str(), scene.width, scene.height,
+                (unsigned long long)result.updates, (unsigned long long)result.frames,
+                result.p50_us, result.p99_us, result.cpu_us_per_frame, result.peak_rss_kb,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    Magick::InitializeMagick(argv[0]);
+
+    std::string filter;
+    std::string json_path;
+    double seconds = 5;
+    ColorMode color_mode = COLOR_MODE_PALETTE256;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--color-mode") == 0 && i + 1 < argc &&
+                   parseColorMode(argv[i + 1], &color_mode)) {
+            i++;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--filter <substring>] [--seconds <s>] "
+                    "[--color-mode palette256|truecolor] [--json <file>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("liv-scene-bench: row kernels %s, color mode %s, %.1f s per scene\n",
+           rowKernels().name, colorModeName(color_mode), seconds);
+
+    const std::vector<Scene> scenes = firmwareScenes();
+    std::vector<std::pair<const Scene*, SceneResult> > results;
+    bool ok = true;
+    for (const Scene& scene : scenes) {
+        if (!filter.empty() && scene.name.find(filter) == std::string::npos) continue;
+
+        SceneResult result;
+        if (!runScene(scene, seconds, color_mode, &result)) {
+            fprintf(stderr, "%s: failed\n", scene.name.c_str());
+            ok = false;
+            continue;
+        }
+        results.push_back(std::make_pair(&scene, result));
+
+        printf("%-28s %6llu frames  p50 %8.1f us  p99 %8.1f us  cpu %8.1f us/frame  peak RSS %6ld KB\n",
+               scene.name.c_str(), (unsigned long long)result.frames, result.p50_us, result.p99_us,
+               result.cpu_us_per_frame, result.peak_rss_kb);
+        fflush(stdout);
+    }
+
+    if (!json_path.empty() && !writeJson(json_path, seconds, color_mode, results)) {
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,18 +1,53 @@
 #include "LedImgViewer.h"
 #include "DisplayManager.h"
+#include "MatrixRenderTarget.h"
 #include "ScreenConfig.h"
+#include "AssetCache.h"
+#include "DiskFrameCache.h"
+#include "FrameProfiler.h"
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <climits>
+#include <algorithm>
 #include <unistd.h>
 #include <string.h>
 #include <sys/wait.h>
 #include <errno.h>
 
+// DisplayManager::wakeFd(): the handlers below wake the main loop out of
+// waitForEvents() so it sees their flag, wherever the signal lands
+static int wake_fd = -1;
+
+static void WakeMainLoop() {
+    const int saved_errno = errno;
+    const uint64_t one = 1;
+    if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0) {
+        // EAGAIN - a wakeup is already pending
+    }
+    errno = saved_errno;
+}
+
 static void InterruptHandler(int signo) {
     printf("\nReceived signal %d, shutting down gracefully...\n", signo);
     interrupt_received = true;
+    WakeMainLoop();
+}
+
+// SIGUSR1: print the command latency histograms from the main loop
+static volatile sig_atomic_t latency_dump_requested = 0;
+
+static void LatencyDumpHandler(int signo) {
+    latency_dump_requested = 1;
+    WakeMainLoop();
+}
+
+// SIGUSR2: write the profiler ring as a Chrome trace (LIV_PROFILE builds)
+static volatile sig_atomic_t trace_dump_requested = 0;
+
+static void TraceDumpHandler(int signo) {
+    trace_dump_requested = 1;
+    WakeMainLoop();
 }
 
 int main(int argc, char *argv[]) {
@@ -43,8 +78,31 @@ int main(int argc, char *argv[]) {
         printf("No config file specified, using default configuration (192x192, ID=1)\n");
     }
     
+    // --capture <file> records this session's serial input (overrides the config)
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            config.serial_capture = argv[i + 1];
+            break;
+        }
+    }
+    
+    // --trace <file> is where SIGUSR2 writes the profiler trace
+    std::string trace_file = "liv-trace.json";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[i + 1];
+            break;
+        }
+    }
+    
     // Print configuration
     config.print();
+    
+    // Decoded GIFs are kept for reuse up to this budget
+    AssetCache::instance().setBudget((size_t)std::max(config.asset_cache_mb, 0) * 1024 * 1024);
+    
+    // Pre-scaled frames are mapped from here instead of decoded (see liv-assetc)
+    DiskFrameCache::setDirectory(config.frame_cache_dir);
 
     // Configure RGB matrix from config
     rgb_matrix::RGBMatrix::Options matrix_options;
@@ -76,8 +134,9 @@ int main(int argc, char *argv[]) {
     // Create display manager
     // If using V-mapper, we need to swap dimensions because V-mapper rotates the display
     bool swap_dimensions = (config.pixel_mapper == "V-mapper");
-    DisplayManager display_manager(matrix, swap_dimensions, config.screen_id);
-    if (!display_manager.init(config.serial_port)) {
+    MatrixRenderTarget render_target(matrix);
+    DisplayManager display_manager(&render_target, swap_dimensions, config.screen_id, config.color_mode);
+    if (!display_manager.init(config.serial_port, config.serial_capture)) {
         fprintf(stderr, "Failed to initialize display manager\n");
         delete matrix;
         return 1;
@@ -112,6 +171,7 @@ int main(int argc, char *argv[]) {
     }
 
     // Set up signal handlers with sigaction for better control
+    wake_fd = display_manager.wakeFd();
     struct sigaction sa;
     sa.sa_handler = InterruptHandler;
     sigemptyset(&sa.sa_mask);
@@ -127,6 +187,18 @@ int main(int argc, char *argv[]) {
         perror("sigaction SIGHUP");
     }
     
+    struct sigaction dump_sa;
+    dump_sa.sa_handler = LatencyDumpHandler;
+    sigemptyset(&dump_sa.sa_mask);
+    dump_sa.sa_flags = 0;
+    if (sigaction(SIGUSR1, &dump_sa, NULL) == -1) {
+        perror("sigaction SIGUSR1");
+    }
+    dump_sa.sa_handler = TraceDumpHandler;
+    if (sigaction(SIGUSR2, &dump_sa, NULL) == -1) {
+        perror("sigaction SIGUSR2");
+    }
+    
     // Ignore SIGPIPE to prevent crashes on broken pipes
     signal(SIGPIPE, SIG_IGN);
 
@@ -135,8 +207,11 @@ int main(int argc, char *argv[]) {
     printf("Screen size: %dx%d\n", matrix->width(), matrix->height());
     printf("Protocol: Direct serial on %s at %d baud\n", config.serial_port.c_str(), config.serial_baudrate);
     printf("Commands: LOAD_GIF, DISPLAY_TEXT, CLEAR_SCREEN, SET_BRIGHTNESS, GET_STATUS\n");
-    printf("Usage: %s [--config <config_file>] [--no-diagnostics] [gif1 gif2 gif3 gif4]\n", argv[0]);
-    printf("Press Ctrl+C to exit\n");
+    printf("Usage: %s [--config <config_file>] [--capture <file>] [--trace <file>] [--no-diagnostics] [gif1 gif2 gif3 gif4]\n", argv[0]);
+    printf("Press Ctrl+C to exit, kill -USR1 %d for command latency stats\n", (int)getpid());
+    if (FrameProfiler::compiledIn()) {
+        printf("Profiler on: kill -USR2 %d writes %s\n", (int)getpid(), trace_file.c_str());
+    }
     printf("======================================\n\n");
 
     // Main loop
@@ -147,8 +222,18 @@ int main(int argc, char *argv[]) {
         // Update display
         display_manager.updateDisplay();
         
-        // Small delay to prevent 100% CPU usage - 30Hz refresh rate
-        usleep(33333); // ~33ms for 30Hz
+        if (latency_dump_requested) {
+            latency_dump_requested = 0;
+            display_manager.dumpLatencyStats();
+        }
+        if (trace_dump_requested) {
+            trace_dump_requested = 0;
+            FrameProfiler::writeChromeTrace(trace_file);
+        }
+        
+        // Sleep until the next frame/blink/scroll deadline or until serial
+        // data arrives - no wakeups at all while the screen is static
+        display_manager.waitForEvents();
     }
 
     printf("\nShutting down gracefully...\n");
@@ -0,0 +1,112 @@
+// Checks the headless render targets: FrameCanvas-like double buffering,
+// clipping, frame hashes and the PPM / Y4M dump sizes.
+//   g++ -std=c++11 -O2 -I.. test_render_target.cpp ../MemoryRenderTarget.cpp -o test_render_target
+#include "MemoryRenderTarget.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+static bool check(bool condition, const char* what) {
+    if (!condition) std::cout << "  FAILED: " << what << std::endl;
+    return condition;
+}
+
+static const uint8_t* pixel(const MemoryRenderTarget& target, int x, int y) {
+    return target.frontPixels() + ((size_t)y * target.width() + x) * 3;
+}
+
+static bool testDoubleBuffering() {
+    MemoryRenderTarget target(64, 512);
+    bool ok = true;
+
+    target.setPixel(1, 2, 10, 20, 30);
+    ok &= check(pixel(target, 1, 2)[0] == 0, "drawing is not visible before swap");
+    target.swap();
+    ok &= check(pixel(target, 1, 2)[0] == 10 && pixel(target, 1, 2)[2] == 30, "swap shows the back buffer");
+
+    // Back buffer now holds the frame before the shown one (all black)
+    target.setPixel(3, 4, 1, 1, 1);
+    target.swap();
+    ok &= check(pixel(target, 1, 2)[0] == 0 && pixel(target, 3, 4)[0] == 1, "back buffer is two frames old");
+    target.swap();
+    ok &= check(pixel(target, 1, 2)[0] == 10, "first frame comes back after two swaps");
+
+    ok &= check(target.swapCount() == 3, "swap count");
+    return ok;
+}
+
+static bool testClipping() {
+    MemoryRenderTarget target(192, 192);
+    bool ok = true;
+
+    uint8_t row[10 * 3];
+    for (int i = 0; i < 10 * 3; i++) row[i] = i + 1;
+
+    // Off-screen writes must be ignored, not crash
+    target.setPixel(-1, 0, 255, 255, 255);
+    target.setPixel(0, 511, 255, 255, 255);
+    target.blitRow(-4, 0, row, 10);
+    target.blitRow(188, 1, row, 10);
+    target.blitRow(0, 192, row, 10);
+    target.swap();
+
+    ok &= check(pixel(target, 0, 0)[0] == 13, "row clipped on the left");
+    ok &= check(pixel(target, 5, 0)[0] == 28 && pixel(target, 6, 0)[0] == 0, "row length after left clip");
+    ok &= check(pixel(target, 188, 1)[0] == 1 && pixel(target, 191, 1)[2] == 12, "row clipped on the right");
+    return ok;
+}
+
+static bool testFrameHash() {
+    MemoryRenderTarget a(64, 64), b(64, 64);
+    bool ok = check(a.frameHash() == b.frameHash(), "equal frames hash equal");
+
+    a.setPixel(63, 63, 0, 0, 1);
+    a.swap();
+    b.swap();
+    ok &= check(a.frameHash() != b.frameHash(), "one changed bit changes the hash");
+
+    a.clear();
+    a.swap();
+    ok &= check(a.frameHash() == b.frameHash(), "clear gives black frame");
+    return ok;
+}
+
+static off_t fileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+static bool testDumps() {
+    const std::string ppm_path = "/tmp/test_render_target.ppm";
+    const std::string y4m_path = "/tmp/test_render_target.y4m";
+    {
+        FrameDumpRenderTarget ppm(64, 32, ppm_path, FrameDumpRenderTarget::PPM);
+        FrameDumpRenderTarget y4m(64, 32, y4m_path, FrameDumpRenderTarget::Y4M, 30);
+        for (int i = 0; i < 3; i++) {
+            ppm.setPixel(i, i, 255, 0, 0);
+            y4m.setPixel(i, i, 255, 0, 0);
+            ppm.swap();
+            y4m.swap();
+        }
+    }
+
+    const off_t frame_bytes = 64 * 32 * 3;
+    const std::string ppm_header = "P6\n64 32\n255\n";
+    const std::string y4m_header = "YUV4MPEG2 W64 H32 F30:1 Ip A1:1 C444\n";
+    bool ok = check(fileSize(ppm_path) == 3 * ((off_t)ppm_header.size() + frame_bytes), "PPM size");
+    ok &= check(fileSize(y4m_path) == (off_t)y4m_header.size() + 3 * (6 + frame_bytes), "Y4M size");
+    unlink(ppm_path.c_str());
+    unlink(y4m_path.c_str());
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok &= testDoubleBuffering();
+    ok &= testClipping();
+    ok &= testFrameHash();
+    ok &= testDumps();
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// Checks every RowKernels variant this CPU supports against the scalar
+// reference on random rows, offsets and lengths.
+//   g++ -std=c++11 -O2 -I.. test_row_kernels.cpp ../RowKernels.cpp ../RowKernelsNeon.cpp -o test_row_kernels
+#include "RowKernels.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static const int MAX_PIXELS = 600;
+static const int ITERATIONS = 20000;
+
+static uint8_t randomByte() {
+    return rand() & 0xFF;
+}
+
+// Masks with long opaque / transparent runs as well as noise
+static uint8_t randomMaskByte(int style) {
+    switch (style) {
+        case 0: return 0x00;
+        case 1: return 0xFF;
+        case 2: return (rand() & 1) ? 0xFF : 0x00;
+        default: return randomByte();
+    }
+}
+
+static bool testMaskedCopy(const RowKernels& kernels) {
+    std::vector<uint8_t> src(MAX_PIXELS * 3), mask((MAX_PIXELS + 7) / 8);
+    std::vector<uint8_t> expected(MAX_PIXELS * 3), actual(MAX_PIXELS * 3);
+
+    for (int iter = 0; iter < ITERATIONS; iter++) {
+        const int style = rand() % 4;
+        for (size_t i = 0; i < src.size(); i++) src[i] = randomByte();
+        for (size_t i = 0; i < mask.size(); i++) mask[i] = randomMaskByte(style);
+        for (size_t i = 0; i < expected.size(); i++) expected[i] = actual[i] = randomByte();
+
+        const int first = rand() % MAX_PIXELS;
+        const int count = rand() % (MAX_PIXELS - first + 1);
+        scalarRowKernels().masked_copy(expected.data(), src.data(), mask.data(), first, count);
+        kernels.masked_copy(actual.data(), src.data(), mask.data(), first, count);
+        if (expected != actual) {
+            std::cout << "  masked_copy mismatch: first=" << first << " count=" << count << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool testColorKeyCopy(const RowKernels& kernels) {
+    std::vector<uint8_t> src(MAX_PIXELS * 3);
+    std::vector<uint8_t> expected(MAX_PIXELS * 3), actual(MAX_PIXELS * 3);
+
+    for (int iter = 0; iter < ITERATIONS; iter++) {
+        const uint32_t key = randomByte() | randomByte() << 8 | randomByte() << 16;
+        const int key_percent = rand() % 101;
+        for (int p = 0; p < MAX_PIXELS; p++) {
+            if (rand() % 100 < key_percent) {
+                src[p * 3 + 0] = key & 0xFF;
+                src[p * 3 + 1] = (key >> 8) & 0xFF;
+                src[p * 3 + 2] = (key >> 16) & 0xFF;
+                // Near misses: one channel off
+                if (rand() % 8 == 0) src[p * 3 + rand() % 3] ^= 1;
+            } else {
+                src[p * 3 + 0] = randomByte();
+                src[p * 3 + 1] = randomByte();
+                src[p * 3 + 2] = randomByte();
+            }
+        }
+        for (size_t i = 0; i < expected.size(); i++) expected[i] = actual[i] = randomByte();
+
+        const int first = rand() % MAX_PIXELS;
+        const int count = rand() % (MAX_PIXELS - first + 1);
+        scalarRowKernels().color_key_copy(expected.data() + first * 3, src.data() + first * 3, count, key);
+        kernels.color_key_copy(actual.data() + first * 3, src.data() + first * 3, count, key);
+        if (expected != actual) {
+            std::cout << "  color_key_copy mismatch: first=" << first << " count=" << count << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool testExpandPalette(const RowKernels& kernels) {
+    uint32_t palette[256];
+    std::vector<uint8_t> indices(MAX_PIXELS);
+    std::vector<uint8_t> expected(MAX_PIXELS * 3), actual(MAX_PIXELS * 3);
+
+    for (int iter = 0; iter < ITERATIONS; iter++) {
+        for (int i = 0; i < 256; i++) {
+            palette[i] = randomByte() | randomByte() << 8 | randomByte() << 16;
+        }
+        for (size_t i = 0; i < indices.size(); i++) indices[i] = randomByte();
+        for (size_t i = 0; i < expected.size(); i++) expected[i] = actual[i] = randomByte();
+
+        const int first = rand() % MAX_PIXELS;
+        const int count = rand() % (MAX_PIXELS - first + 1);
+        scalarRowKernels().expand_palette(expected.data() + first * 3, indices.data() + first, count, palette);
+        kernels.expand_palette(actual.data() + first * 3, indices.data() + first, count, palette);
+        if (expected != actual) {
+            std::cout << "  expand_palette mismatch: first=" << first << " count=" << count << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    srand(1234);
+
+    bool ok = true;
+    std::vector<const RowKernels*> variants = availableRowKernels();
+    for (size_t i = 0; i < variants.size(); i++) {
+        const RowKernels& kernels = *variants[i];
+        bool passed = testMaskedCopy(kernels) && testColorKeyCopy(kernels) && testExpandPalette(kernels);
+        std::cout << kernels.name << ": " << (passed ? "OK" : "FAILED") << std::endl;
+        ok = ok && passed;
+    }
+
+    std::cout << "Selected: " << rowKernels().name << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,376 @@
+// ESP32 stand-in on a pseudo-terminal: SerialProtocol is opened on the pty
+// slave exactly like /dev/ttyUSB0 and read the way the viewer's serial
+// thread reads it, while traffic patterns are written to the master side -
+// back-to-back packets, interleaved screen IDs, line noise, an ESP32 boot
+// log, the USB cable pulled. Reports delivered commands/s, drop rate and
+// per-command latency (written to the master -> parsed), and fails if a
+// pattern loses commands it must not lose or the reader spins on a hang-up.
+//   g++ -std=c++11 -O2 -I.. test_serial_link.cpp ../SerialProtocol.cpp ../SerialCapture.cpp -o test_serial_link -lutil -pthread
+//   ./test_serial_link [--packets <n>] [--baud <bits/s>] [--pattern <name>]
+#include "SerialProtocol.h"
+#include <pty.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint64_t GetTimeInMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// What the ESP32 prints on the same UART when it resets
+static const char BOOT_LOG[] =
+    "ets Jun  8 2016 00:22:57\r\n\r\n"
+    "rst:0x1 (POWERON_RESET),boot:0x13 (SPI_FAST_FLASH_BOOT)\r\n"
+    "configsip: 0, SPIWP:0xee\r\n"
+    "clk_drv:0x00,q_drv:0x00,d_drv:0x00,cs0_drv:0x00,hd_drv:0x00,wp_drv:0x00\r\n"
+    "mode:DIO, clock div:1\r\n"
+    "load:0x3fff0030,len:1344\r\n"
+    "load:0x40078000,len:13964\r\n"
+    "load:0x40080400,len:3600\r\n"
+    "entry 0x400805f0\r\n"
+    "E (412) psram: PSRAM ID read error: 0xffffffff\r\n"
+    "[   118][I][esp32-hal-psram.c:96] psramInit(): PSRAM enabled\r\n"
+    "[   245][D][WiFiGeneric.cpp:929] _eventCallback(): Arduino Event: 0 - WIFI_READY\r\n"
+    "[   331][V][WiFiGeneric.cpp:338] _arduino_event_cb(): STA Started\r\n"
+    "[   338][D][WiFiGeneric.cpp:929] _eventCallback(): Arduino Event: 2 - STA_START\r\n"
+    "Monster 3in1 PRO-GAMES POLAND, firmware build Oct 12 2025 13:37:00\r\n"
+    "FRAM ok, Credit=3 Record=987, matrix link /dev/ttyUSB0 1000000 baud\r\n";
+
+struct LinkPattern {
+    const char* name;
+    bool interleave_screens;   // Alternate screen ID 1 and 2
+    int max_noise_bytes;       // Random bytes before each packet (0 = none)
+    bool boot_log;             // ESP32 reset half way through
+    bool hang_up;              // Master closed half way through (USB unplugged)
+};
+
+static const LinkPattern PATTERNS[] = {
+    {"back_to_back", false, 0, false, false},
+    {"interleaved_screens", true, 0, false, false},
+    {"line_noise", true, 48, false, false},
+    {"boot_log", false, 0, true, false},
+    {"hang_up", false, 0, false, true},
+};
+
+// How long the reader is watched after a hang-up, and the CPU time it may
+// use meanwhile: a reader spinning on the dead port uses all of it
+static const uint64_t HANG_UP_WATCH_US = 1500000;
+static const uint64_t HANG_UP_MAX_CPU_US = 100000;
+static const uint64_t REOPEN_INTERVAL_US = 1000000;  // DisplayManager::SERIAL_REOPEN_INTERVAL_US
+
+struct LinkResult {
+    uint64_t sent;
+    uint64_t delivered;
+    uint64_t must_deliver;      // Sent outside the restart grace period
+    uint64_t lost_must_deliver;
+    uint64_t corrupt;           // Parsed, but not a command we sent
+    uint64_t bytes;
+    uint64_t elapsed_us;
+    bool hung_up;               // Reader saw the hang-up
+    uint64_t hang_up_cpu_us;    // Reader CPU time from the hang-up to the end
+    std::vector<uint64_t> latency_us;
+};
+
+static uint64_t ThreadCpuMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// One DISPLAY_TEXT packet carrying its sequence number
+static void appendTextPacket(std::vector<uint8_t>* out, uint8_t screen_id, uint32_t sequence) {
+    TextCommand text;
+    memset(&text, 0, sizeof(text));
+    text.screen_id = screen_id;
+    text.command = CMD_DISPLAY_TEXT;
+    text.element_id = sequence % 200;
+    text.x_pos = 5;
+    text.y_pos = 26;
+    text.color_r = 255;
+    snprintf(text.text, sizeof(text.text), "SEQ %u", sequence);
+    text.text_length = strlen(text.text);
+    strcpy(text.font_name, "fonts/9x18B.bdf");
+
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(&text);
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < sizeof(text); i++) checksum ^= payload[i];
+
+    const uint8_t header[] = {PROTOCOL_PREAMBLE_1, PROTOCOL_PREAMBLE_2, PROTOCOL_PREAMBLE_3,
+                              PROTOCOL_SOF, screen_id, CMD_DISPLAY_TEXT, (uint8_t)sizeof(text)};
+    out->insert(out->end(), header, header + sizeof(header));
+    out->insert(out->end(), payload, payload + sizeof(text));
+    out->push_back(checksum);
+    out->push_back(PROTOCOL_EOF);
+}
+
+static bool writeAll(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            perror("write");
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool runPattern(const LinkPattern& pattern, uint32_t packets, uint64_t baud, LinkResult* result) {
+    int master = -1, slave = -1;
+    char slave_name[64];
+    if (openpty(&master, &slave, slave_name, nullptr, nullptr) != 0) {
+        perror("openpty");
+        return false;
+    }
+
+    SerialProtocol protocol;
+    if (!protocol.init(slave_name)) {
+        close(master);
+        close(slave);
+        return false;
+    }
+
+    // Send time of each sequence number; 0 = not sent yet
+    std::unique_ptr<std::atomic<uint64_t>[]> sent_at(new std::atomic<uint64_t>[packets]);
+    std::unique_ptr<std::atomic<bool>[]> received(new std::atomic<bool>[packets]);
+    for (uint32_t i = 0; i < packets; i++) {
+        sent_at[i].store(0);
+        received[i].store(false);
+    }
+
+    // Receiver: the viewer's serial thread, minus the hand-off queue
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> delivered(0), corrupt(0);
+    std::vector<uint64_t> latency_us;
+    bool hung_up = false;
+    uint64_t hang_up_cpu_us = 0;
+    std::thread receiver([&]() {
+        uint64_t next_reopen = 0;
+        while (!stop.load()) {
+            struct pollfd pfd;
+            pfd.fd = protocol.getFd();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            poll(&pfd, 1, 10);
+            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                if (pfd.revents & POLLIN) {
+                    protocol.processData();
+                }
+                protocol.close();
+                next_reopen = GetTimeInMicros() + REOPEN_INTERVAL_US;
+                if (!hung_up) {
+                    hung_up = true;
+                    hang_up_cpu_us = ThreadCpuMicros();
+                }
+            } else if (pfd.revents & POLLIN) {
+                protocol.processData();
+            } else if (pfd.fd < 0 && GetTimeInMicros() >= next_reopen) {
+                protocol.reopen();
+                next_reopen = GetTimeInMicros() + REOPEN_INTERVAL_US;
+            }
+            while (void* command = protocol.getNextCommand()) {
+                const uint64_t now = GetTimeInMicros();
+                unsigned sequence = 0;
+                if (protocol.getCommandType(command) == CMD_DISPLAY_TEXT &&
+                    sscanf(static_cast<TextCommand*>(command)->text, "SEQ %u", &sequence) == 1 &&
+                    sequence < packets && sent_at[sequence].load() != 0 && !received[sequence].exchange(true)) {
+                    latency_us.push_back(now - sent_at[sequence].load());
+                    delivered++;
+                } else {
+                    corrupt++;
+                }
+                protocol.freeCommand(command);
+            }
+        }
+        if (hung_up) {
+            hang_up_cpu_us = ThreadCpuMicros() - hang_up_cpu_us;
+        }
+    });
+
+    // At baud bits/s (10 bits per byte on the UART); 0 = as fast as the pty takes it
+    const double us_per_byte = baud > 0 ? 10e6 / baud : 0;
+    const uint64_t start = GetTimeInMicros();
+    uint64_t bytes = 0;
+    uint64_t grace_start = 0, grace_end = 0;
+    unsigned noise_seed = 12345;
+    std::vector<uint8_t> buffer;
+    bool ok = true;
+
+    for (uint32_t sequence = 0; sequence < packets && ok; sequence++) {
+        if (pattern.hang_up && sequence == packets / 2) {
+            // The rest is never sent; the reader must sit idle, not spin
+            usleep(20000);
+            close(master);
+            master = -1;
+            usleep(HANG_UP_WATCH_US);
+            break;
+        }
+        if (pattern.boot_log && sequence == packets / 2) {
+            // Give the log its own read(), as after a real reset, then send
+            // at 100 packets/s until the 2 s grace period is well over
+            usleep(20000);
+            grace_start = GetTimeInMicros();
+            ok = writeAll(master, reinterpret_cast<const uint8_t*>(BOOT_LOG), sizeof(BOOT_LOG) - 1);
+            bytes += sizeof(BOOT_LOG) - 1;
+            grace_end = GetTimeInMicros() + 2000000 + 100000;  // Grace period plus scheduling slack
+            usleep(20000);
+        }
+
+        buffer.clear();
+        for (int i = rand_r(&noise_seed) % (pattern.max_noise_bytes + 1); i > 0; i--) {
+            buffer.push_back((uint8_t)rand_r(&noise_seed));
+        }
+        const uint8_t screen_id = (pattern.interleave_screens && (sequence & 1)) ? 2 : 1;
+        appendTextPacket(&buffer, screen_id, sequence);
+
+        sent_at[sequence].store(GetTimeInMicros());
+        ok = writeAll(master, buffer.data(), buffer.size());
+        bytes += buffer.size();
+
+        if (grace_start && GetTimeInMicros() < grace_end + 500000) {
+            usleep(10000);
+        } else if (us_per_byte > 0) {
+            const uint64_t due = start + (uint64_t)(bytes * us_per_byte);
+            const uint64_t now = GetTimeInMicros();
+            if (due > now) usleep(due - now);
+        }
+    }
+
+    // Wait for the receiver to catch up (or give up after 500 ms of silence)
+    uint64_t last_count = delivered.load() + corrupt.load();
+    uint64_t last_change = GetTimeInMicros();
+    while (delivered.load() < packets && GetTimeInMicros() - last_change < 500000) {
+        usleep(1000);
+        const uint64_t count = delivered.load() + corrupt.load();
+        if (count != last_count) {
+            last_count = count;
+            last_change = GetTimeInMicros();
+        }
+    }
+    const uint64_t end = std::min(GetTimeInMicros(), last_change);
+    stop.store(true);
+    receiver.join();
+    protocol.close();
+    if (master >= 0) close(master);
+    close(slave);
+
+    result->sent = 0;
+    result->delivered = delivered.load();
+    result->corrupt = corrupt.load();
+    result->bytes = bytes;
+    result->elapsed_us = end > start ? end - start : 1;
+    result->hung_up = hung_up;
+    result->hang_up_cpu_us = hang_up_cpu_us;
+    result->must_deliver = 0;
+    result->lost_must_deliver = 0;
+    for (uint32_t i = 0; i < packets; i++) {
+        const uint64_t sent = sent_at[i].load();
+        if (sent == 0) continue;
+        result->sent++;
+        if (grace_start && sent >= grace_start && sent < grace_end) continue;
+        result->must_deliver++;
+        if (!received[i].load()) result->lost_must_deliver++;
+    }
+    result->latency_us = latency_us;
+    std::sort(result->latency_us.begin(), result->latency_us.end());
+    return ok;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t packets = 2000;
+    uint64_t baud = 0;
+    std::string only;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--packets") == 0 && i + 1 < argc) {
+            packets = std::max(2, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--packets <n>] [--baud <bits/s>] [--pattern <name>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // SerialProtocol logs every byte; results go to the original stdout
+    fflush(stdout);
+    FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (!report || null_fd < 0) {
+        perror("stdout");
+        return 1;
+    }
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    fprintf(report, "%-20s %6s %9s %7s %10s %8s %8s %8s %8s\n",
+            "pattern", "sent", "delivered", "drop%", "cmds/s", "MB/s", "p50 us", "p99 us", "max us");
+    bool ok = true;
+    for (const LinkPattern& pattern : PATTERNS) {
+        if (!only.empty() && only != pattern.name) continue;
+
+        LinkResult result;
+        if (!runPattern(pattern, packets, baud, &result)) {
+            fprintf(report, "%-20s FAILED to run\n", pattern.name);
+            ok = false;
+            continue;
+        }
+
+        const double seconds = result.elapsed_us / 1e6;
+        fprintf(report, "%-20s %6llu %9llu %6.2f%% %10.0f %8.2f %8llu %8llu %8llu\n", pattern.name,
+                (unsigned long long)result.sent, (unsigned long long)result.delivered,
+                100.0 * (result.sent - result.delivered) / result.sent,
+                result.delivered / seconds, result.bytes / seconds / 1e6,
+                (unsigned long long)percentile(result.latency_us, 50),
+                (unsigned long long)percentile(result.latency_us, 99),
+                (unsigned long long)(result.latency_us.empty() ? 0 : result.latency_us.back()));
+
+        // Only commands sent into the restart grace period may be dropped
+        if (result.lost_must_deliver > 0) {
+            fprintf(report, "  FAILED: %llu of %llu commands lost outside the restart grace period\n",
+                    (unsigned long long)result.lost_must_deliver, (unsigned long long)result.must_deliver);
+            ok = false;
+        }
+        if (pattern.hang_up && !result.hung_up) {
+            fprintf(report, "  FAILED: reader never saw the hang-up\n");
+            ok = false;
+        } else if (pattern.hang_up) {
+            fprintf(report, "  reader CPU after hang-up: %llu us in %llu ms\n",
+                    (unsigned long long)result.hang_up_cpu_us, (unsigned long long)(HANG_UP_WATCH_US / 1000));
+            if (result.hang_up_cpu_us > HANG_UP_MAX_CPU_US) {
+                fprintf(report, "  FAILED: reader spins on the hung-up port\n");
+                ok = false;
+            }
+        }
+        if (result.corrupt > 0) {
+            fprintf(report, "  FAILED: %llu commands parsed that were never sent\n",
+                    (unsigned long long)result.corrupt);
+            ok = false;
+        }
+        fflush(report);
+    }
+
+    fprintf(report, "%s\n", ok ? "OK" : "FAILED");
+    fclose(report);
+    return ok ? 0 : 1;
+}
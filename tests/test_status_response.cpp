@@ -0,0 +1,102 @@
+// Sends GET_STATUS sized responses through SerialProtocol::sendResponse on a
+// pseudo-terminal and checks the packets the ESP32 would receive: the
+// one-byte payload_length must not wrap, data longer than fits is cut to
+// PROTOCOL_MAX_RESPONSE_DATA bytes, and the checksum must match.
+//   g++ -std=c++11 -O2 -I.. test_status_response.cpp ../SerialProtocol.cpp ../SerialCapture.cpp ../LatencyTrace.cpp -o test_status_response -lutil -pthread
+#include "SerialProtocol.h"
+#include <pty.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Read one response packet (preamble + ProtocolPacket) from the master side
+static bool readPacket(int master, ProtocolPacket* packet) {
+    uint8_t buffer[3 + sizeof(ProtocolPacket)];
+    size_t received = 0;
+    while (received < sizeof(buffer)) {
+        struct pollfd pfd;
+        pfd.fd = master;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 1000) <= 0) return false;
+        const ssize_t n = read(master, buffer + received, sizeof(buffer) - received);
+        if (n <= 0) return false;
+        received += n;
+    }
+    if (buffer[0] != PROTOCOL_PREAMBLE_1 || buffer[1] != PROTOCOL_PREAMBLE_2 ||
+        buffer[2] != PROTOCOL_PREAMBLE_3) {
+        return false;
+    }
+    memcpy(packet, buffer + 3, sizeof(ProtocolPacket));
+    return true;
+}
+
+static bool testResponse(SerialProtocol& protocol, int master, size_t data_len) {
+    std::vector<uint8_t> data(data_len);
+    for (size_t i = 0; i < data_len; i++) data[i] = (uint8_t)('A' + i % 26);
+
+    protocol.sendResponse(1, RESP_OK, data.data(), data.size());
+
+    ProtocolPacket packet;
+    if (!readPacket(master, &packet)) {
+        std::cout << "FAIL " << data_len << " bytes: no packet" << std::endl;
+        return false;
+    }
+
+    const size_t expected_len = std::min(data_len, (size_t)PROTOCOL_MAX_RESPONSE_DATA);
+    uint8_t checksum = 0;
+    for (int i = 0; i < packet.payload_length; i++) checksum ^= packet.payload[i];
+    const Response* response = reinterpret_cast<const Response*>(packet.payload);
+
+    bool ok = true;
+    if (packet.sof != PROTOCOL_SOF || packet.eof != PROTOCOL_EOF || packet.command != CMD_RESPONSE) {
+        std::cout << "FAIL " << data_len << " bytes: bad framing" << std::endl;
+        ok = false;
+    }
+    if (packet.payload_length != 4 + expected_len) {
+        std::cout << "FAIL " << data_len << " bytes: payload_length " << (int)packet.payload_length
+                  << ", expected " << 4 + expected_len << std::endl;
+        ok = false;
+    }
+    if (packet.checksum != checksum) {
+        std::cout << "FAIL " << data_len << " bytes: checksum mismatch" << std::endl;
+        ok = false;
+    }
+    if (response->data_length != expected_len || memcmp(response->data, data.data(), expected_len) != 0) {
+        std::cout << "FAIL " << data_len << " bytes: data_length " << (int)response->data_length
+                  << ", expected " << expected_len << std::endl;
+        ok = false;
+    }
+    if (ok) {
+        std::cout << "ok   " << data_len << " bytes -> payload_length " << (int)packet.payload_length << std::endl;
+    }
+    return ok;
+}
+
+int main() {
+    int master = -1, slave = -1;
+    char slave_name[64];
+    if (openpty(&master, &slave, slave_name, nullptr, nullptr) != 0) {
+        perror("openpty");
+        return 1;
+    }
+
+    SerialProtocol protocol;
+    if (!protocol.init(slave_name)) {
+        return 1;
+    }
+
+    bool ok = true;
+    const size_t sizes[] = {0, 40, PROTOCOL_MAX_RESPONSE_DATA, PROTOCOL_MAX_RESPONSE_DATA + 1, 300};
+    for (size_t data_len : sizes) {
+        ok = testResponse(protocol, master, data_len) && ok;
+    }
+
+    close(master);
+    close(slave);
+    std::cout << (ok ? "All status response tests passed" : "Status response tests FAILED") << std::endl;
+    return ok ? 0 : 1;
+}